@@ -21,13 +21,29 @@
  * 
  */
 #include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#if defined(SIMULATE) || defined(SMALL_ARENAS) || defined(PRESSURE_PURGE)
+#include <sys/mman.h>
+#endif
+#ifdef PRESSURE_PURGE
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#endif
+#if defined(PRESSURE_PURGE) || defined(PARALLEL_CHECK)
+#include <pthread.h>
+#endif
+#if defined(SIMULATE) && defined(SMALL_ARENAS)
+#error "SMALL_ARENAS commits real memory and cannot be simulated"
+#endif
 
 #include "mm.h"
 #include "memlib.h"
+#include "mm_ext.h"
 
 /* If you want debugging output, use the following macro.  When you hand
  * in, remove the #define DEBUG line. */
@@ -62,10 +78,37 @@
 /* Pack a size and allocated bit into a word */
 #define PACK(size, prex, alloc) ((size) | (prex) | (alloc))
 
+#ifndef SIMULATE
 /* Read and write a word at address p */
 #define GET(p) (*(unsigned int *)(p))
 #define PUT(p, val) (*(unsigned int *)(p) = (val))
 
+/* Read and write the list link stored in free block bp */
+#define GET_LINK(bp) ((size_t *)*(size_t *)(bp))
+#define PUT_LINK(bp, val) (*(size_t *)(bp) = (size_t)(val))
+#else
+/* 
+ * Simulation mode: the heap is only a range of virtual addresses.
+ * Every tag sits in the 16 bytes around a block boundary bp: the
+ * footer before it at bp - 8, its header at bp - 4 and its link at
+ * bp. A hash table keeps one record per live boundary, so the
+ * metadata grows with the number of blocks, not with the heap.
+ */
+#define SIM_BASE ((char *)0x100000000UL)
+#define SIM_MAX_HEAP (1UL << 35) /* boundary offsets / 8 fit in 32 bits */
+#define SIM_MIN_TAGS (1 << 12)
+
+#define GET(p) sim_get(p)
+#define PUT(p, val) sim_put(p, val)
+#define GET_LINK(bp) sim_get_link(bp)
+#define PUT_LINK(bp, val) sim_put_link(bp, (void *)(val))
+
+#define mem_sbrk sim_sbrk
+#define mem_heap_lo sim_heap_lo
+#define mem_heap_hi sim_heap_hi
+#define mem_heapsize sim_heapsize
+#endif /* def SIMULATE */
+
 /* Read the size and allocated fields from address p */
 #define GET_SIZE(p) (GET(p) & ~0x7)
 #define GET_ALLOC(p) (GET(p) & 0x1)
@@ -81,6 +124,10 @@
 /* check whether the prev block is allocated*/
 #define PREVX(bp) (GET(bp) & 0x4)
 
+/* check whether a free block was purged, any PACK of its tags clears it */
+#define PURGED 0x2
+#define GET_PURGED(p) (GET(p) & PURGED)
+
 /* define the boundaries of lists */
 #define num01 12
 #define num02 16
@@ -97,6 +144,65 @@
 #define num13 4096
 #define num14 8192
 
+/* the hot segments of lists 13 to 15 hold at most HOT_MAX blocks each */
+#define HOT_LISTS 3
+#define HOT_MAX 16
+/* the cold segments: COLD_SUB size buckets per power of two from 2^11 */
+#define COLD_SUB_BITS 2
+#define COLD_SUB (1 << COLD_SUB_BITS)
+#define COLD_MIN_SHIFT 11
+#define COLD_BUCKETS 64 /* one bit each in cold_map */
+
+/* realloc keeps a shrunk block whole if less than this would be freed */
+#define REALLOC_SLACK num07
+
+/* the signal-safe pool: SIGPOOL_WORDS bitmap words of 64 slots each */
+#define SIGPOOL_SLOT 256
+#define SIGPOOL_WORDS 4
+#define SIGPOOL_SLOTS (SIGPOOL_WORDS * 64)
+
+/* the transfer cache: batches of TC_BATCH blocks per exact block size */
+#define TC_MAX_SIZE 128
+#define TC_CLASSES (TC_MAX_SIZE / DSIZE + 1)
+#define TC_BATCH 16
+#define TC_SLOTS 8
+#define TC_OPEN_BYTES (2 * 1024) /* cap of one thread's open batches, one batch of the largest size */
+#define TC_FULL_BYTES (4 * 1024) /* cap of the shared full batches */
+
+/* the call-site bins: SITE_BINS sites, SITE_BIN_MAX blocks each */
+#define SITE_BINS 16
+#define SITE_BIN_MAX 16
+#define SITE_BIN_BYTES (8 * 1024) /* cap of one bin, larger blocks are never binned */
+#define SITE_MAP 4096
+#define SITE_HASH(x, n) ((((size_t)(x) >> 3) * 0x9E3779B97F4A7C15UL) >> 32 & ((n) - 1))
+/* blocks hash by heap offset, so a simulated heap maps them the same way */
+#define SITE_OWNER(bp) (&site_map[SITE_HASH((char *)(bp) - (char *)mem_heap_lo(), SITE_MAP)])
+
+/* the small-object arenas: 2 MiB regions cut into runs of one size */
+#define ARENA_MAX 128
+#define ARENA_CLASSES (ARENA_MAX / ALIGNMENT + 1)
+#define ARENA_REGION (1UL << 21)
+#define ARENA_RUN (1UL << 14)
+#define ARENA_RUNS (ARENA_REGION / ARENA_RUN)
+#define ARENA_OF(p) ((struct arena_region *)((size_t)(p) & ~(ARENA_REGION - 1)))
+
+/* the pressure-aware purge: pressure is kept in per-mille */
+#define PRESSURE_PERIOD_MS 1000
+#define PRESSURE_CGROUP "/sys/fs/cgroup"
+#define PRESSURE_PSI "/proc/pressure/memory"
+#define PURGE_TICK 1024       /* look at the clock once every PURGE_TICK frees */
+#define PURGE_DECAY_MS 10000  /* purge period with no pressure */
+#define PURGE_DECAY_MIN_MS 50 /* purge period at full pressure */
+#define PURGE_MIN_SIZE num14  /* smallest block purged at full pressure */
+
+/* the parallel heap check runs at most CHECK_THREADS threads */
+#define CHECK_THREADS 16
+#ifdef HOT_COLD
+#define CHECK_LISTS (15 + HOT_LISTS + COLD_BUCKETS)
+#else
+#define CHECK_LISTS 15
+#endif
+
 /* the start of the heap */
 static char *heap_listp = 0;
 
@@ -107,7 +213,46 @@ static void *find_fit(size_t asize);
 static void *coalesce(void *bp);
 static void insertx(void *bp, size_t asize);
 static void deletex(void *bp, size_t asize);
+static void free_block(void *ptr);
 void mm_checkheap(int lineno);
+#ifdef SIMULATE
+static void sim_reset(void);
+static unsigned int sim_get(const void *p);
+static void sim_put(void *p, unsigned int val);
+static size_t *sim_get_link(const void *bp);
+static void sim_put_link(void *bp, void *val);
+static void sim_drop(void *bp);
+#endif /* def SIMULATE */
+#ifdef TRANSFER_CACHE
+static void *tc_malloc(size_t asize);
+static int tc_free(void *ptr);
+static void tc_reset(void);
+#endif /* def TRANSFER_CACHE */
+#ifdef CALLSITE_BINS
+static void *site_malloc(void *site, size_t asize);
+static void site_record(void *site, void *bp);
+static int site_free(void *ptr);
+static void site_reset(void);
+#endif /* def CALLSITE_BINS */
+#ifdef SMALL_ARENAS
+static int in_heap(const void *p);
+static void *arena_malloc(size_t size);
+static void arena_free(void *ptr);
+static size_t arena_size(void *ptr);
+static void arena_reset(void);
+#endif /* def SMALL_ARENAS */
+#ifdef PRESSURE_PURGE
+static void purge_tick(void);
+#endif /* def PRESSURE_PURGE */
+#ifdef HOT_COLD
+static int hot_index(size_t asize);
+static int hot_insert(void *bp, size_t asize);
+static int hot_delete(void *bp);
+static void *hot_fit(size_t asize);
+static int cold_index(size_t size);
+static int cold_delete(void *bp);
+static void *cold_fit(size_t asize);
+#endif /* def HOT_COLD */
 
 /* define the groups of the lists */
 static size_t *list_start = 0;
@@ -127,6 +272,123 @@ static size_t *l13 = 0;
 static size_t *l14 = 0;
 static size_t *l15 = 0;
 
+#ifdef HOT_COLD
+/*
+ * With HOT_COLD, lists 13 to 15 are each split in two. The hot
+ * segment keeps the most recently freed blocks in LIFO order and is
+ * searched first. The cold segments of all three replace l13, l14
+ * and l15 with size buckets, LIFO inside, and cold_map marks the
+ * buckets that are not empty, so a fit is found without scanning
+ * past blocks that are too small.
+ */
+static size_t *hot[HOT_LISTS];
+static int hot_count[HOT_LISTS];
+static size_t *cold[COLD_BUCKETS];
+static uint64_t cold_map = 0;
+#endif /* def HOT_COLD */
+
+#ifdef SIGNAL_POOL
+/* the pre-reserved signal-safe pool and its occupancy bitmap */
+static size_t signal_pool[SIGPOOL_SLOTS * SIGPOOL_SLOT / sizeof(size_t)];
+static volatile uint64_t signal_map[SIGPOOL_WORDS];
+#endif /* def SIGNAL_POOL */
+
+#ifdef TRANSFER_CACHE
+/*
+ * A batch of cached blocks of one size. The blocks stay marked as
+ * allocated in the heap, so they are never coalesced or listed.
+ */
+struct tc_batch
+{
+    int count;
+    void *blocks[TC_BATCH];
+};
+
+/*
+ * The batch each thread fills and drains, one per block size, and
+ * the bytes they hold. They are only valid for the generation they
+ * were filled in, so mm_init can drop every thread's batches at once.
+ */
+static __thread struct tc_batch tc_open[TC_CLASSES];
+static __thread size_t tc_open_bytes = 0;
+static __thread unsigned int tc_open_generation = 0;
+/* the full batches shared between threads, their bytes and their lock */
+static struct tc_batch tc_full[TC_CLASSES][TC_SLOTS];
+static int tc_nfull[TC_CLASSES];
+static size_t tc_full_bytes = 0;
+static volatile unsigned int tc_generation = 1;
+static volatile int tc_lock = 0;
+#endif /* def TRANSFER_CACHE */
+
+#ifdef CALLSITE_BINS
+/*
+ * A call site and the blocks it allocated that were freed since.
+ * The blocks stay marked as allocated and are linked through their
+ * payload. heat ages the site so that a busier one can take its slot.
+ */
+struct site_bin
+{
+    void *site;
+    size_t *blocks;
+    size_t bytes;
+    int count;
+    int heat;
+};
+
+/* which site allocated a live block, direct mapped by block offset */
+struct site_owner
+{
+    void *bp;
+    void *site;
+    struct site_bin *bin;
+};
+
+static struct site_bin site_bins[SITE_BINS];
+static struct site_owner site_map[SITE_MAP];
+#endif /* def CALLSITE_BINS */
+
+#ifdef SMALL_ARENAS
+/*
+ * The header at the start of every region. All metadata the small
+ * path needs lives here, next to the objects in the same huge page:
+ * the free list and the uncarved part of the current run per class,
+ * and the class of every run. Run 0 holds only this header.
+ * A region with a non-empty free list of a class is on that class's
+ * list of regions with free objects, linked through avail.
+ */
+struct arena_region
+{
+    struct arena_region *next;
+    struct arena_region *avail[ARENA_CLASSES];
+    size_t *free[ARENA_CLASSES];
+    char *bump[ARENA_CLASSES];
+    char *bump_end[ARENA_CLASSES];
+    int runs;
+    unsigned char run_class[ARENA_RUNS];
+};
+
+static struct arena_region *arena_list = NULL;
+/* per class, the regions whose free list of that class is not empty */
+static struct arena_region *arena_avail[ARENA_CLASSES];
+/* the bytes of all runs handed out so far, header runs included */
+static size_t arena_bytes = 0;
+#endif /* def SMALL_ARENAS */
+
+#ifdef PRESSURE_PURGE
+/* the latest pressure, written only by the background thread */
+static volatile int pressure_level = 0;
+static volatile int pressure_running = 0;
+static pthread_t pressure_thread;
+/* wakes the background thread early when it is stopped */
+static pthread_mutex_t pressure_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pressure_wake;
+static char pressure_cgroup[256];
+static char pressure_psi[256];
+/* the purge state, touched only by the allocating thread */
+static unsigned int purge_frees = 0;
+static long purge_last_ms = 0;
+#endif /* def PRESSURE_PURGE */
+
 /*
  * Initialize: initialize the heap and lists
  * return -1 on error, 0 on success.
@@ -150,6 +412,24 @@ int mm_init(void)
     l13 = NULL;
     l14 = NULL;
     l15 = NULL;
+#ifdef HOT_COLD
+    memset(hot, 0, sizeof(hot));
+    memset(hot_count, 0, sizeof(hot_count));
+    memset(cold, 0, sizeof(cold));
+    cold_map = 0;
+#endif /* def HOT_COLD */
+#ifdef SIMULATE
+    sim_reset();
+#endif /* def SIMULATE */
+#ifdef TRANSFER_CACHE
+    tc_reset();
+#endif /* def TRANSFER_CACHE */
+#ifdef CALLSITE_BINS
+    site_reset();
+#endif /* def CALLSITE_BINS */
+#ifdef SMALL_ARENAS
+    arena_reset();
+#endif /* def SMALL_ARENAS */
 
     if ((heap_listp = mem_sbrk(4 * WSIZE)) == (void *)-1)
         return -1;
@@ -175,8 +455,19 @@ int mm_init(void)
  * If the block does not exists, extend the heap.
  * If the block exists, place the required size into
  * the block.
+ * With CALLSITE_BINS every public entry point takes its own
+ * caller as the site and passes it down to mm_malloc_at.
  */
+#ifdef CALLSITE_BINS
+void *malloc(size_t size)
+{
+    return mm_malloc_at(size, __builtin_return_address(0));
+}
+
+void *mm_malloc_at(size_t size, void *site)
+#else
 void *malloc(size_t size)
+#endif /* def CALLSITE_BINS */
 {
     size_t asize;      /* Adjusted block size */
     size_t extendsize; /* Amount to extend heap if no fit */
@@ -188,16 +479,34 @@ void *malloc(size_t size)
     /* Ignore spurious requests */
     if (size <= 0)
         return NULL;
+#ifdef SMALL_ARENAS
+    /* Small objects come from the huge-page arenas */
+    if (size <= ARENA_MAX && (bp = arena_malloc(size)) != NULL)
+        return bp;
+#endif /* def SMALL_ARENAS */
     /* Adjust block size to include overhead and alignment reqs. */
     if (size <= DSIZE)
         asize = 2 * DSIZE;
     else
         asize = DSIZE * (((WSIZE) + size + (DSIZE - 1)) / DSIZE);
+#ifdef TRANSFER_CACHE
+    /* Take a cached block of exactly this size if there is one */
+    if ((bp = tc_malloc(asize)) != NULL)
+        return bp;
+#endif /* def TRANSFER_CACHE */
+#ifdef CALLSITE_BINS
+    /* Reuse a block freed by the same call site if one fits */
+    if ((bp = site_malloc(site, asize)) != NULL)
+        return bp;
+#endif /* def CALLSITE_BINS */
 
     /* Search the free list for a fit */
     if ((bp = find_fit(asize)) != NULL)
     {
         bp = place(bp, asize);
+#ifdef CALLSITE_BINS
+        site_record(site, bp);
+#endif /* def CALLSITE_BINS */
         return bp;
     }
     /* No fit found. Get more memory and place the block */
@@ -207,6 +516,9 @@ void *malloc(size_t size)
     
     /* the bp may be modified */
     bp = place(bp, asize);
+#ifdef CALLSITE_BINS
+    site_record(site, bp);
+#endif /* def CALLSITE_BINS */
     return bp;
 }
 
@@ -223,6 +535,37 @@ void free(void *ptr)
     {
         mm_init();
     }
+#ifdef PRESSURE_PURGE
+    /* every free counts, also those the caches and arenas keep */
+    purge_tick();
+#endif /* def PRESSURE_PURGE */
+#ifdef SMALL_ARENAS
+    /* Objects outside the heap belong to the arenas */
+    if (!in_heap(ptr))
+    {
+        arena_free(ptr);
+        return;
+    }
+#endif /* def SMALL_ARENAS */
+#ifdef TRANSFER_CACHE
+    /* Keep small blocks in the cache instead of the lists */
+    if (tc_free(ptr))
+        return;
+#endif /* def TRANSFER_CACHE */
+#ifdef CALLSITE_BINS
+    /* Keep the block in the bin of the site that allocated it */
+    if (site_free(ptr))
+        return;
+#endif /* def CALLSITE_BINS */
+    free_block(ptr);
+}
+
+/*
+ * free_block - Mark an allocated block free, update the next
+ * block and coalesce it into the lists.
+ */
+static void free_block(void *ptr)
+{
     size_t size = GET_SIZE(HDRP(ptr));
     size_t checkprev = PREVX(HDRP(ptr));
     /* Initialize free block header/footer and the epilogue header */
@@ -245,13 +588,15 @@ void free(void *ptr)
 }
 
 /*
- * realloc - Change the size of the block by mallocing 
- * a new block, copying its data, and freeing the old 
- * block.  
+ * realloc - Change the size of the block. If the new size
+ * still fits in the block, keep it in place and only split
+ * off a large enough remainder. Otherwise malloc a new block,
+ * copy its data, and free the old block.
  */
 void *realloc(void *oldptr, size_t size)
 {
     size_t oldsize;
+    size_t asize;
     void *newptr;
     /* If size == 0 then this is just free, and we return NULL. */
     if (size == 0)
@@ -262,19 +607,62 @@ void *realloc(void *oldptr, size_t size)
     /* If oldptr is NULL, then this is just malloc. */
     if (oldptr == NULL)
     {
+#ifdef CALLSITE_BINS
+        return mm_malloc_at(size, __builtin_return_address(0));
+#else
         return mm_malloc(size);
+#endif /* def CALLSITE_BINS */
+    }
+#ifdef SMALL_ARENAS
+    if (!in_heap(oldptr))
+    {
+        if (size <= arena_size(oldptr))
+            return oldptr;
+    }
+    else
+#endif /* def SMALL_ARENAS */
+    {
+        /* Adjust block size the same way as malloc does */
+        if (size <= DSIZE)
+            asize = 2 * DSIZE;
+        else
+            asize = DSIZE * (((WSIZE) + size + (DSIZE - 1)) / DSIZE);
+        oldsize = GET_SIZE(HDRP(oldptr));
+        if (asize <= oldsize)
+        {
+            if (oldsize - asize >= REALLOC_SLACK)
+            {
+                /* give the tail back as an allocated block being freed */
+                PUT(HDRP(oldptr), PACK(asize, PREVX(HDRP(oldptr)), 1));
+                newptr = NEXT_BLKP(oldptr);
+                PUT(HDRP(newptr), PACK(oldsize - asize, 4, 1));
+                free_block(newptr);
+            }
+            return oldptr;
+        }
     }
+#ifdef CALLSITE_BINS
+    newptr = mm_malloc_at(size, __builtin_return_address(0));
+#else
     newptr = mm_malloc(size);
+#endif /* def CALLSITE_BINS */
     /* If realloc() fails the original block is left untouched  */
     if (!newptr)
     {
         return 0;
     }
     /* Copy the old data. */
+#ifdef SMALL_ARENAS
+    if (!in_heap(oldptr))
+        oldsize = arena_size(oldptr);
+    else
+#endif /* def SMALL_ARENAS */
     oldsize = GET_SIZE(HDRP(oldptr));
     if (size < oldsize)
         oldsize = size;
+#ifndef SIMULATE
     memcpy(newptr, oldptr, oldsize);
+#endif
     /* Free the old block. */
     mm_free(oldptr);
     return newptr;
@@ -287,11 +675,606 @@ void *calloc(size_t nmemb, size_t size)
 {
     size_t bytes = nmemb * size;
     void *newptr;
+#ifdef CALLSITE_BINS
+    newptr = mm_malloc_at(bytes, __builtin_return_address(0));
+#else
     newptr = malloc(bytes);
+#endif /* def CALLSITE_BINS */
+#ifndef SIMULATE
     memset(newptr, 0, bytes);
+#endif
     return newptr;
 }
 
+#ifdef SIGNAL_POOL
+/*
+ * mm_malloc_signal_safe - Allocate a slot of at most SIGPOOL_SLOT
+ * bytes from the pre-reserved pool. It never touches the lists or
+ * calls mem_sbrk, and only claims slots with compare-and-swap on the
+ * bitmap, so it can be called from a signal handler even while
+ * malloc or free is interrupted. Return NULL if the pool is used up.
+ */
+void *mm_malloc_signal_safe(size_t size)
+{
+    int i;
+    if (size == 0 || size > SIGPOOL_SLOT)
+        return NULL;
+    for (i = 0; i < SIGPOOL_WORDS; i++)
+    {
+        uint64_t map = signal_map[i];
+        while (~map != 0)
+        {
+            int bit = __builtin_ctzll(~map);
+            if (__sync_bool_compare_and_swap(&signal_map[i], map, map | ((uint64_t)1 << bit)))
+            {
+                return (char *)signal_pool + (size_t)(i * 64 + bit) * SIGPOOL_SLOT;
+            }
+            /* another context claimed a slot first, reload and retry */
+            map = signal_map[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * mm_free_signal_safe - Return a slot got from mm_malloc_signal_safe
+ * to the pool. Pointers that are not the start of a slot are ignored.
+ */
+void mm_free_signal_safe(void *ptr)
+{
+    char *start = (char *)signal_pool;
+    size_t slot;
+    if ((char *)ptr < start || (char *)ptr >= start + sizeof(signal_pool))
+        return;
+    /* only the start of a slot was ever handed out */
+    if (((char *)ptr - start) % SIGPOOL_SLOT != 0)
+        return;
+    slot = ((char *)ptr - start) / SIGPOOL_SLOT;
+    __sync_fetch_and_and(&signal_map[slot / 64], ~((uint64_t)1 << (slot % 64)));
+}
+#endif /* def SIGNAL_POOL */
+
+#ifdef TRANSFER_CACHE
+/*
+ * tc_open_batches - Return this thread's open batches, dropping them
+ * first if they were filled before the last mm_init
+ */
+static struct tc_batch *tc_open_batches(void)
+{
+    if (tc_open_generation != tc_generation)
+    {
+        memset(tc_open, 0, sizeof(tc_open));
+        tc_open_bytes = 0;
+        tc_open_generation = tc_generation;
+    }
+    return tc_open;
+}
+
+/*
+ * tc_malloc - Pop a cached block of exactly asize bytes. If the
+ * thread's open batch is empty, refill it with a whole batch from
+ * the transfer cache. Return NULL if neither has one.
+ */
+static void *tc_malloc(size_t asize)
+{
+    struct tc_batch *open;
+    size_t c = asize / DSIZE;
+    if (asize > TC_MAX_SIZE)
+        return NULL;
+    open = &tc_open_batches()[c];
+    if (open->count == 0)
+    {
+        while (__sync_lock_test_and_set(&tc_lock, 1))
+            ;
+        if (tc_nfull[c] > 0)
+        {
+            tc_nfull[c] --;
+            memcpy(open, &tc_full[c][tc_nfull[c]], sizeof(struct tc_batch));
+            tc_full_bytes -= open->count * asize;
+            tc_open_bytes += open->count * asize;
+        }
+        __sync_lock_release(&tc_lock);
+        if (open->count == 0)
+            return NULL;
+    }
+    open->count --;
+    tc_open_bytes -= asize;
+    return open->blocks[open->count];
+}
+
+/*
+ * tc_free - Push a small block into the thread's open batch. A full
+ * batch of TC_BATCH blocks is handed to the transfer cache whole, or
+ * back to the lists if the transfer cache already holds TC_SLOTS
+ * batches of the size or TC_FULL_BYTES. Once the thread's batches
+ * would hold more than TC_OPEN_BYTES, the partial batch of the size
+ * goes back to the lists and the block is not cached, so cached
+ * blocks never pin more than a bounded part of the heap. Return 0 if
+ * the block is not cached.
+ */
+static int tc_free(void *ptr)
+{
+    struct tc_batch *open;
+    size_t size = GET_SIZE(HDRP(ptr));
+    size_t c = size / DSIZE;
+    int i, full = 0;
+    if (size > TC_MAX_SIZE)
+        return 0;
+    open = &tc_open_batches()[c];
+    if (open->count == TC_BATCH)
+    {
+        while (__sync_lock_test_and_set(&tc_lock, 1))
+            ;
+        if (tc_nfull[c] < TC_SLOTS && tc_full_bytes + TC_BATCH * size <= TC_FULL_BYTES)
+        {
+            memcpy(&tc_full[c][tc_nfull[c]], open, sizeof(struct tc_batch));
+            tc_nfull[c] ++;
+            tc_full_bytes += TC_BATCH * size;
+            full = 1;
+        }
+        __sync_lock_release(&tc_lock);
+    }
+    if (open->count == TC_BATCH || tc_open_bytes + size > TC_OPEN_BYTES)
+    {
+        /* the batch went to the transfer cache, or is released whole */
+        for (i = 0; i < open->count && !full; i++)
+            free_block(open->blocks[i]);
+        tc_open_bytes -= open->count * size;
+        open->count = 0;
+        if (tc_open_bytes + size > TC_OPEN_BYTES)
+            return 0;
+    }
+    open->blocks[open->count] = ptr;
+    open->count ++;
+    tc_open_bytes += size;
+    return 1;
+}
+
+/*
+ * tc_reset - Empty the transfer cache and start a new generation, so
+ * that every thread drops its open batches on its next call
+ */
+static void tc_reset(void)
+{
+    memset(tc_nfull, 0, sizeof(tc_nfull));
+    tc_full_bytes = 0;
+    tc_generation ++;
+}
+#endif /* def TRANSFER_CACHE */
+
+#ifdef CALLSITE_BINS
+/*
+ * site_malloc - Take a block freed by the same call site that fits
+ * asize without wasting a minimum block. Return NULL if none does.
+ */
+static void *site_malloc(void *site, size_t asize)
+{
+    struct site_bin *bin = &site_bins[SITE_HASH(site, SITE_BINS)];
+    size_t *prev = NULL;
+    size_t *bp;
+    if (bin->site != site)
+        return NULL;
+    if (bin->heat < SITE_BIN_MAX)
+        bin->heat ++;
+    for (bp = bin->blocks; bp != NULL; prev = bp, bp = GET_LINK(bp))
+    {
+        size_t size = GET_SIZE(HDRP(bp));
+        if (size >= asize && size - asize < 2 * DSIZE)
+        {
+            if (prev == NULL)
+                bin->blocks = GET_LINK(bp);
+            else
+                PUT_LINK(prev, GET_LINK(bp));
+            bin->count --;
+            bin->bytes -= size;
+            site_record(site, bp);
+            return bp;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * site_record - Remember that site allocated bp. A site whose slot
+ * is held by another one cools it down and takes the slot once it
+ * is cold, handing the old site's blocks back to the lists.
+ */
+static void site_record(void *site, void *bp)
+{
+    struct site_bin *bin = &site_bins[SITE_HASH(site, SITE_BINS)];
+    struct site_owner *owner = SITE_OWNER(bp);
+    if (bin->site != site)
+    {
+        if (bin->heat > 0)
+        {
+            bin->heat --;
+            return;
+        }
+        while (bin->blocks != NULL)
+        {
+            size_t *next = GET_LINK(bin->blocks);
+            free_block(bin->blocks);
+            bin->blocks = next;
+        }
+        bin->site = site;
+        bin->bytes = 0;
+        bin->count = 0;
+        bin->heat = 1;
+    }
+    owner->bp = bp;
+    owner->site = site;
+    owner->bin = bin;
+}
+
+/*
+ * site_free - Push a block into the bin of the site that allocated
+ * it. Return 0 if the site is unknown, no longer owns its bin, or
+ * its bin would hold more than SITE_BIN_MAX blocks or SITE_BIN_BYTES.
+ */
+static int site_free(void *ptr)
+{
+    struct site_owner *owner = SITE_OWNER(ptr);
+    struct site_bin *bin = owner->bin;
+    size_t size;
+    if (owner->bp != ptr)
+        return 0;
+    owner->bp = NULL;
+    /* the site lost its slot since, so the block is not the bin's */
+    if (owner->site != bin->site || bin->count == SITE_BIN_MAX)
+        return 0;
+    size = GET_SIZE(HDRP(ptr));
+    if (bin->bytes + size > SITE_BIN_BYTES)
+        return 0;
+    PUT_LINK(ptr, bin->blocks);
+    bin->blocks = ptr;
+    bin->bytes += size;
+    bin->count ++;
+    return 1;
+}
+
+/*
+ * site_reset - Forget all sites and their blocks
+ */
+static void site_reset(void)
+{
+    memset(site_bins, 0, sizeof(site_bins));
+    memset(site_map, 0, sizeof(site_map));
+}
+#endif /* def CALLSITE_BINS */
+
+#ifdef SMALL_ARENAS
+/*
+ * arena_new - Map a new 2 MiB aligned region, ask for it to be
+ * backed by a huge page and put it in front of the region list.
+ */
+static struct arena_region *arena_new(void)
+{
+    char *map = mmap(NULL, 2 * ARENA_REGION, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    char *start;
+    struct arena_region *region;
+    if (map == MAP_FAILED)
+        return NULL;
+    /* keep the aligned middle and give back the rest */
+    start = (char *)ARENA_OF(map + ARENA_REGION - 1);
+    if (start != map)
+        munmap(map, start - map);
+    munmap(start + ARENA_REGION, map + ARENA_REGION - start);
+#ifdef MADV_HUGEPAGE
+    madvise(start, ARENA_REGION, MADV_HUGEPAGE);
+#endif
+    region = (struct arena_region *)start;
+    region->runs = 1;
+    arena_bytes += ARENA_RUN;
+    region->next = arena_list;
+    arena_list = region;
+    return region;
+}
+
+/*
+ * arena_take - Take an object of class c from the current run of
+ * region, carving a new run when it is used up. Return NULL if the
+ * region has no run left for this class.
+ */
+static void *arena_take(struct arena_region *region, size_t c)
+{
+    size_t *bp;
+    if (region->bump[c] == region->bump_end[c])
+    {
+        if (region->runs == ARENA_RUNS)
+            return NULL;
+        region->run_class[region->runs] = c;
+        region->bump[c] = (char *)region + region->runs * ARENA_RUN;
+        region->bump_end[c] = region->bump[c] + ARENA_RUN / (c * ALIGNMENT) * (c * ALIGNMENT);
+        region->runs ++;
+        arena_bytes += ARENA_RUN;
+    }
+    bp = (size_t *)region->bump[c];
+    region->bump[c] += c * ALIGNMENT;
+    return bp;
+}
+
+/*
+ * arena_malloc - Allocate a small object, first from a freed object
+ * of any region, then from the regions' runs, newest region first,
+ * and then from a new region. Freed objects go first so that no run
+ * is carved while older regions still hold free objects of the class.
+ */
+static void *arena_malloc(size_t size)
+{
+    size_t c = (size + ALIGNMENT - 1) / ALIGNMENT;
+    struct arena_region *region = arena_avail[c];
+    size_t *bp;
+    if (region != NULL)
+    {
+        bp = region->free[c];
+        if ((region->free[c] = GET_LINK(bp)) == NULL)
+            arena_avail[c] = region->avail[c];
+        return bp;
+    }
+    for (region = arena_list; region != NULL; region = region->next)
+    {
+        if ((bp = arena_take(region, c)) != NULL)
+            return bp;
+    }
+    if ((region = arena_new()) == NULL)
+        return NULL;
+    return arena_take(region, c);
+}
+
+/*
+ * arena_free - Push a small object onto its region's free list, and
+ * the region onto the class's list when the free list was empty.
+ * The region and class are found from the address alone.
+ */
+static void arena_free(void *ptr)
+{
+    struct arena_region *region = ARENA_OF(ptr);
+    size_t c = region->run_class[((char *)ptr - (char *)region) / ARENA_RUN];
+    if (region->free[c] == NULL)
+    {
+        region->avail[c] = arena_avail[c];
+        arena_avail[c] = region;
+    }
+    PUT_LINK(ptr, region->free[c]);
+    region->free[c] = ptr;
+}
+
+/*
+ * arena_size - Return the usable size of a small object
+ */
+static size_t arena_size(void *ptr)
+{
+    struct arena_region *region = ARENA_OF(ptr);
+    return region->run_class[((char *)ptr - (char *)region) / ARENA_RUN] * ALIGNMENT;
+}
+
+/*
+ * mm_arena_bytes - Return the bytes the arenas use outside the heap,
+ * to be added to mem_heapsize() when reporting the heap size
+ */
+size_t mm_arena_bytes(void)
+{
+    return arena_bytes;
+}
+
+/*
+ * arena_reset - Unmap every region
+ */
+static void arena_reset(void)
+{
+    while (arena_list != NULL)
+    {
+        struct arena_region *next = arena_list->next;
+        munmap(arena_list, ARENA_REGION);
+        arena_list = next;
+    }
+    memset(arena_avail, 0, sizeof(arena_avail));
+    arena_bytes = 0;
+}
+#endif /* def SMALL_ARENAS */
+
+#ifdef PRESSURE_PURGE
+/*
+ * pressure_file - Read a small file into buf without going through
+ * stdio, which would call back into malloc from the background
+ * thread. Return the number of bytes read, or -1 on error.
+ */
+static int pressure_file(const char *dir, const char *name, char *buf, int len)
+{
+    char path[512];
+    int fd, n;
+    if (name != NULL)
+        snprintf(path, sizeof(path), "%s/%s", dir, name);
+    else
+        snprintf(path, sizeof(path), "%s", dir);
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return -1;
+    n = read(fd, buf, len - 1);
+    close(fd);
+    if (n < 0)
+        return -1;
+    buf[n] = 0;
+    return n;
+}
+
+/*
+ * mm_pressure_read - Return the memory pressure in per-mille: the
+ * larger of the cgroup v2 usage against its limit and the PSI
+ * "some avg10" stall percentage. Missing files count as no pressure.
+ */
+int mm_pressure_read(const char *cgroup_dir, const char *psi_file)
+{
+    char buf[256];
+    char *avg;
+    int level = 0;
+    if (pressure_file(cgroup_dir, "memory.current", buf, sizeof(buf)) > 0)
+    {
+        unsigned long long current = strtoull(buf, NULL, 10);
+        /* memory.max is "max" when the cgroup has no limit */
+        if (pressure_file(cgroup_dir, "memory.max", buf, sizeof(buf)) > 0 &&
+            strncmp(buf, "max", 3) != 0)
+        {
+            unsigned long long limit = strtoull(buf, NULL, 10);
+            if (limit > 0)
+                level = (int)(current >= limit ? 1000 : current * 1000 / limit);
+        }
+    }
+    if (pressure_file(psi_file, NULL, buf, sizeof(buf)) > 0 &&
+        (avg = strstr(buf, "some avg10=")) != NULL)
+    {
+        int psi = (int)(strtod(avg + strlen("some avg10="), NULL) * 10);
+        level = MAX(level, psi);
+    }
+    return level > 1000 ? 1000 : level;
+}
+
+/*
+ * pressure_loop - Refresh the pressure level every PRESSURE_PERIOD_MS,
+ * sleeping on pressure_wake so that mm_pressure_stop never waits
+ * out the period.
+ */
+static void *pressure_loop(void *arg)
+{
+    struct timespec ts;
+    (void)arg;
+    pthread_mutex_lock(&pressure_lock);
+    while (pressure_running)
+    {
+        pressure_level = mm_pressure_read(pressure_cgroup, pressure_psi);
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        ts.tv_sec += PRESSURE_PERIOD_MS / 1000;
+        ts.tv_nsec += (PRESSURE_PERIOD_MS % 1000) * 1000000L;
+        if (ts.tv_nsec >= 1000000000L)
+        {
+            ts.tv_sec ++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        while (pressure_running &&
+               pthread_cond_timedwait(&pressure_wake, &pressure_lock, &ts) != ETIMEDOUT)
+            ;
+    }
+    pthread_mutex_unlock(&pressure_lock);
+    return NULL;
+}
+
+/*
+ * mm_pressure_start - Start the background thread watching the
+ * cgroup directory and PSI file, NULL meaning the system ones.
+ * Return -1 on error, 0 on success.
+ */
+int mm_pressure_start(const char *cgroup_dir, const char *psi_file)
+{
+    pthread_condattr_t attr;
+    if (pressure_running)
+        return -1;
+    snprintf(pressure_cgroup, sizeof(pressure_cgroup), "%s",
+             cgroup_dir != NULL ? cgroup_dir : PRESSURE_CGROUP);
+    snprintf(pressure_psi, sizeof(pressure_psi), "%s",
+             psi_file != NULL ? psi_file : PRESSURE_PSI);
+    pressure_level = mm_pressure_read(pressure_cgroup, pressure_psi);
+    /* the deadlines of pressure_loop are on the monotonic clock */
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&pressure_wake, &attr);
+    pthread_condattr_destroy(&attr);
+    pressure_running = 1;
+    if (pthread_create(&pressure_thread, NULL, pressure_loop, NULL) != 0)
+    {
+        pressure_running = 0;
+        pthread_cond_destroy(&pressure_wake);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * mm_pressure_stop - Stop the background thread
+ */
+void mm_pressure_stop(void)
+{
+    if (!pressure_running)
+        return;
+    pthread_mutex_lock(&pressure_lock);
+    pressure_running = 0;
+    pthread_cond_signal(&pressure_wake);
+    pthread_mutex_unlock(&pressure_lock);
+    pthread_join(pressure_thread, NULL);
+    pthread_cond_destroy(&pressure_wake);
+    pressure_level = 0;
+}
+
+/*
+ * purge_block - Give the whole pages inside free block bp back to
+ * the system and mark both of its tags as purged. The link and the
+ * boundary tags stay, so the lists and coalescing are untouched.
+ */
+static void purge_block(void *bp)
+{
+#ifndef SIMULATE
+    size_t page = mem_pagesize();
+    char *start = (char *)(((size_t)bp + DSIZE + page - 1) & ~(page - 1));
+    char *end = (char *)((size_t)FTRP(bp) & ~(page - 1));
+    if (end > start)
+        madvise(start, end - start, MADV_DONTNEED);
+#endif /* ndef SIMULATE */
+    PUT(HDRP(bp), GET(HDRP(bp)) | PURGED);
+    PUT(FTRP(bp), GET(FTRP(bp)) | PURGED);
+}
+
+/*
+ * purge - Purge the large free blocks that are not purged yet.
+ * Higher pressure purges smaller blocks, from PURGE_MIN_SIZE at
+ * full pressure to 16 times that at none. A block that is split,
+ * coalesced or allocated gets fresh tags and may be purged again.
+ * With HOT_COLD only the cold segments are purged.
+ */
+static void purge(int level)
+{
+    size_t threshold = (size_t)PURGE_MIN_SIZE << (4 * (1000 - level) / 1000);
+    int i;
+#ifdef HOT_COLD
+    size_t **lists = cold;
+    int first = cold_index(threshold), count = COLD_BUCKETS;
+#else
+    size_t *lists[2];
+    int first = 0, count = 2;
+    lists[0] = l14;
+    lists[1] = l15;
+#endif /* def HOT_COLD */
+    for (i = first; i < count; i++)
+    {
+        size_t *bp;
+        for (bp = lists[i]; bp != NULL; bp = GET_LINK(bp))
+        {
+            if (GET_PURGED(HDRP(bp)) || GET_SIZE(HDRP(bp)) < threshold)
+                continue;
+            purge_block(bp);
+        }
+    }
+}
+
+/*
+ * purge_tick - Purge once the decay time has passed since the last
+ * purge. The decay time shrinks as the pressure grows.
+ */
+static void purge_tick(void)
+{
+    struct timespec ts;
+    long now, decay;
+    int level = pressure_level;
+    if (!pressure_running || ++purge_frees % PURGE_TICK != 0)
+        return;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+    decay = PURGE_DECAY_MIN_MS + (long)(PURGE_DECAY_MS - PURGE_DECAY_MIN_MS) * (1000 - level) / 1000;
+    if (now - purge_last_ms < decay)
+        return;
+    purge_last_ms = now;
+    purge(level);
+}
+#endif /* def PRESSURE_PURGE */
+
 /*
  * Return whether the pointer is in the heap.
  */
@@ -393,7 +1376,7 @@ void mm_checkheap(int lineno)
     else
     {
         size_t* startx = l01;
-        for(; startx != NULL; startx = (size_t*)*startx)
+        for(; startx != NULL; startx = GET_LINK(startx))
         {
             cnt1 ++;
             if (!in_heap(startx))
@@ -416,7 +1399,7 @@ void mm_checkheap(int lineno)
     else
     {
         size_t* startx = l02;
-        for(; startx != NULL; startx = (size_t*)*startx)
+        for(; startx != NULL; startx = GET_LINK(startx))
         {
             cnt1 ++;
             if (!in_heap(startx))
@@ -439,7 +1422,7 @@ void mm_checkheap(int lineno)
     else
     {
         size_t* startx = l03;
-        for(; startx != NULL; startx = (size_t*)*startx)
+        for(; startx != NULL; startx = GET_LINK(startx))
         {
             cnt1 ++;
             if (!in_heap(startx))
@@ -462,7 +1445,7 @@ void mm_checkheap(int lineno)
     else
     {
         size_t* startx = l04;
-        for(; startx != NULL; startx = (size_t*)*startx)
+        for(; startx != NULL; startx = GET_LINK(startx))
         {
             cnt1 ++;
             if (!in_heap(startx))
@@ -485,7 +1468,7 @@ void mm_checkheap(int lineno)
     else
     {
         size_t* startx = l05;
-        for(; startx != NULL; startx = (size_t*)*startx)
+        for(; startx != NULL; startx = GET_LINK(startx))
         {
             cnt1 ++;
             if (!in_heap(startx))
@@ -508,7 +1491,7 @@ void mm_checkheap(int lineno)
     else
     {
         size_t* startx = l06;
-        for(; startx != NULL; startx = (size_t*)*startx)
+        for(; startx != NULL; startx = GET_LINK(startx))
         {
             cnt1 ++;
             if (!in_heap(startx))
@@ -531,7 +1514,7 @@ void mm_checkheap(int lineno)
     else
     {
         size_t* startx = l07;
-        for(; startx != NULL; startx = (size_t*)*startx)
+        for(; startx != NULL; startx = GET_LINK(startx))
         {
             cnt1 ++;
             if (!in_heap(startx))
@@ -554,7 +1537,7 @@ void mm_checkheap(int lineno)
     else
     {
         size_t* startx = l08;
-        for(; startx != NULL; startx = (size_t*)*startx)
+        for(; startx != NULL; startx = GET_LINK(startx))
         {
             cnt1 ++;
             if (!in_heap(startx))
@@ -577,7 +1560,7 @@ void mm_checkheap(int lineno)
     else
     {
         size_t* startx = l09;
-        for(; startx != NULL; startx = (size_t*)*startx)
+        for(; startx != NULL; startx = GET_LINK(startx))
         {
             cnt1 ++;
             if (!in_heap(startx))
@@ -600,7 +1583,7 @@ void mm_checkheap(int lineno)
     else
     {
         size_t* startx = l10;
-        for(; startx != NULL; startx = (size_t*)*startx)
+        for(; startx != NULL; startx = GET_LINK(startx))
         {
             cnt1 ++;
             if (!in_heap(startx))
@@ -623,7 +1606,7 @@ void mm_checkheap(int lineno)
     else
     {
         size_t* startx = l11;
-        for(; startx != NULL; startx = (size_t*)*startx)
+        for(; startx != NULL; startx = GET_LINK(startx))
         {
             cnt1 ++;
             if (!in_heap(startx))
@@ -646,7 +1629,7 @@ void mm_checkheap(int lineno)
     else
     {
         size_t* startx = l12;
-        for(; startx != NULL; startx = (size_t*)*startx)
+        for(; startx != NULL; startx = GET_LINK(startx))
         {
             cnt1 ++;
             if (!in_heap(startx))
@@ -669,74 +1652,379 @@ void mm_checkheap(int lineno)
     else
     {
         size_t* startx = l13;
-        for(; startx != NULL; startx = (size_t*)*startx)
+        for(; startx != NULL; startx = GET_LINK(startx))
+        {
+            cnt1 ++;
+            if (!in_heap(startx))
+            {
+                printf("Block Out Of Range Error!\n");
+                exit(0);
+            }
+            printf("The Current Block Is %p With Size %d\n", startx, GET_SIZE(HDRP(startx)));
+            if (GET_SIZE(HDRP(startx)) > num13)
+            {
+                printf("Block Size Out Of Range Error!\n");
+            }
+        }
+    }
+    printf("Now We Are Checking List14\n");
+    if (l14 == NULL)
+    {
+        printf("List14 Is Empty\n");
+    }
+    else
+    {
+        size_t* startx = l14;
+        for(; startx != NULL; startx = GET_LINK(startx))
+        {
+            cnt1 ++;
+            if (!in_heap(startx))
+            {
+                printf("Block Out Of Range Error!\n");
+                exit(0);
+            }
+            printf("The Current Block Is %p With Size %d\n", startx, GET_SIZE(HDRP(startx)));
+            if (GET_SIZE(HDRP(startx)) > num14)
+            {
+                printf("Block Size Out Of Range Error!\n");
+            }
+        }
+    }
+    printf("Now We Are Checking List15\n");
+    if (l15 == NULL)
+    {
+        printf("List15 Is Empty\n");
+    }
+    else
+    {
+        size_t* startx = l15;
+        for(; startx != NULL; startx = GET_LINK(startx))
+        {
+            cnt1 ++;
+            if (!in_heap(startx))
+            {
+                printf("Block Out Of Range Error!\n");
+                exit(0);
+            }
+            printf("The Current Block Is %p With Size %d\n", startx, GET_SIZE(HDRP(startx)));
+            if (GET_SIZE(HDRP(startx)) <= num14)
+            {
+                printf("Block Size Out Of Range Error!\n");
+            }
+        }
+    }
+#ifdef HOT_COLD
+    int h;
+    for (h = 0; h < HOT_LISTS; h++)
+    {
+        printf("Now We Are Checking Hot List%02d\n", h + 13);
+        size_t* startx = hot[h];
+        for(; startx != NULL; startx = GET_LINK(startx))
+        {
+            cnt1 ++;
+            if (!in_heap(startx))
+            {
+                printf("Block Out Of Range Error!\n");
+                exit(0);
+            }
+            printf("The Current Block Is %p With Size %d\n", startx, GET_SIZE(HDRP(startx)));
+            if (GET_SIZE(HDRP(startx)) <= num12 || hot_index(GET_SIZE(HDRP(startx))) != h)
+            {
+                printf("Block Size Out Of Range Error!\n");
+            }
+        }
+    }
+    for (h = 0; h < COLD_BUCKETS; h++)
+    {
+        if ((cold[h] != NULL) != ((cold_map >> h) & 1))
+        {
+            printf("Cold Bucket%02d Map Error!\n", h);
+        }
+        size_t* startx = cold[h];
+        for(; startx != NULL; startx = GET_LINK(startx))
         {
             cnt1 ++;
             if (!in_heap(startx))
             {
-                printf("Block Out Of Range Error!\n");
-                exit(0);
+                printf("Block Out Of Range Error!\n");
+                exit(0);
+            }
+            printf("The Current Block Is %p With Size %d\n", startx, GET_SIZE(HDRP(startx)));
+            if (GET_SIZE(HDRP(startx)) <= num12 || cold_index(GET_SIZE(HDRP(startx))) != h)
+            {
+                printf("Block Size Out Of Range Error!\n");
+            }
+        }
+    }
+#endif /* def HOT_COLD */
+    printf("Free Blocks Number Is %d\n", cnt);
+    if (cnt != cnt1)
+    {
+        printf("Free Blocks Numbers Match Error!\n");
+        exit(0);
+    }
+}
+
+#ifdef PARALLEL_CHECK
+/*
+ * The work of one checking thread. In the first phase it checks
+ * some of the lists and finds, for every segment, the first free
+ * block at or after the segment's nominal start. In the second
+ * phase it walks the heap from one such checkpoint to the next.
+ */
+struct check_job
+{
+    int id;
+    int threads;
+    size_t **lists;
+    char **targets;
+    char *first[CHECK_THREADS];
+    char *start;
+    char *end;
+    long free_listed;
+    long free_walked;
+    int errors;
+};
+
+/*
+ * list_index - Return which list insertx puts a free block of size in
+ */
+static int list_index(size_t size)
+{
+    if (size <= num01) return 0;
+    if (size <= num02) return 1;
+    if (size <= num03) return 2;
+    if (size == num04) return 3;
+    if (size == num05) return 4;
+    if (size <= num06) return 5;
+    if (size <= num07) return 6;
+    if (size <= num08) return 7;
+    if (size <= num09) return 8;
+    if (size <= num10) return 9;
+    if (size <= num11) return 10;
+    if (size <= num12) return 11;
+    if (size <= num13) return 12;
+    if (size <= num14) return 13;
+    return 14;
+}
+
+/*
+ * list_holds - Return whether list i of the check may hold a free
+ * block of size. The hot segments and then the cold buckets come
+ * after the 15 lists.
+ */
+static int list_holds(int i, size_t size)
+{
+    if (i < 15)
+        return list_index(size) == i;
+#ifdef HOT_COLD
+    if (size <= num12)
+        return 0;
+    if (i < 15 + HOT_LISTS)
+        return hot_index(size) == i - 15;
+    return cold_index(size) == i - 15 - HOT_LISTS;
+#else
+    return 0;
+#endif /* def HOT_COLD */
+}
+
+/*
+ * check_lists - Check the lists given to this thread and note the
+ * first free block at or after every segment target.
+ */
+static void *check_lists(void *arg)
+{
+    struct check_job *job = arg;
+    long limit = (long)(mem_heapsize() / (2 * DSIZE)) + 1;
+    int i, k;
+    for (k = 0; k < job->threads; k++)
+        job->first[k] = NULL;
+    for (i = job->id; i < CHECK_LISTS; i += job->threads)
+    {
+        size_t *bp;
+        long n = 0;
+        for (bp = job->lists[i]; bp != NULL; bp = GET_LINK(bp))
+        {
+            if (!in_heap(bp) || !aligned(bp) || ++n > limit)
+            {
+                printf("List%02d Block Out Of Range Error!\n", i + 1);
+                job->errors ++;
+                break;
+            }
+            if (GET_ALLOC(HDRP(bp)))
+            {
+                printf("List%02d Allocated Block Error!\n", i + 1);
+                job->errors ++;
+            }
+            if (!list_holds(i, GET_SIZE(HDRP(bp))))
+            {
+                printf("List%02d Block Size Out Of Range Error!\n", i + 1);
+                job->errors ++;
             }
-            printf("The Current Block Is %p With Size %d\n", startx, GET_SIZE(HDRP(startx)));
-            if (GET_SIZE(HDRP(startx)) > num13)
+            for (k = 1; k < job->threads; k++)
             {
-                printf("Block Size Out Of Range Error!\n");
+                if ((char *)bp >= job->targets[k] &&
+                    (job->first[k] == NULL || (char *)bp < job->first[k]))
+                    job->first[k] = (char *)bp;
             }
+            job->free_listed ++;
         }
     }
-    printf("Now We Are Checking List14\n");
-    if (l14 == NULL)
-    {
-        printf("List14 Is Empty\n");
-    }
-    else
+    return NULL;
+}
+
+/*
+ * check_walk - Walk the blocks from start up to end, checking what
+ * mm_checkheap checks on every block.
+ */
+static void *check_walk(void *arg)
+{
+    struct check_job *job = arg;
+    char *bp = job->start;
+    int prev_alloc = 1;
+    while (bp < job->end)
     {
-        size_t* startx = l14;
-        for(; startx != NULL; startx = (size_t*)*startx)
+        if (!aligned(bp))
         {
-            cnt1 ++;
-            if (!in_heap(startx))
+            printf("Block %p Aligned Error!\n", bp);
+            job->errors ++;
+            return NULL;
+        }
+        /* only the epilogue has size 0, and it is past the segment */
+        if (GET_SIZE(HDRP(bp)) == 0)
+        {
+            printf("Block %p Unexpected EOL Error!\n", bp);
+            job->errors ++;
+            return NULL;
+        }
+        if ((PREVX(HDRP(bp)) != 0) != prev_alloc)
+        {
+            printf("Block %p Previous Allocated Bit Error!\n", bp);
+            job->errors ++;
+        }
+        prev_alloc = GET_ALLOC(HDRP(bp));
+        if (!prev_alloc)
+        {
+            job->free_walked ++;
+            if (PREVX(HDRP(bp)) == 0)
             {
-                printf("Block Out Of Range Error!\n");
-                exit(0);
+                printf("Block %p Consecutive Free Blocks Error!\n", bp);
+                job->errors ++;
             }
-            printf("The Current Block Is %p With Size %d\n", startx, GET_SIZE(HDRP(startx)));
-            if (GET_SIZE(HDRP(startx)) > num14)
+            if (GET(HDRP(bp)) != GET(FTRP(bp)))
             {
-                printf("Block Size Out Of Range Error!\n");
+                printf("Block %p Header And Footer Match Error!\n", bp);
+                job->errors ++;
             }
         }
+        bp = NEXT_BLKP(bp);
     }
-    printf("Now We Are Checking List15\n");
-    if (l15 == NULL)
+    if (bp != job->end)
     {
-        printf("List15 Is Empty\n");
+        printf("Segment %p Boundary Error!\n", job->start);
+        job->errors ++;
     }
-    else
+    return NULL;
+}
+
+/*
+ * check_run - Run fn on every job in a thread of its own, or inline
+ * when no thread can be created, and wait for all of them.
+ */
+static void check_run(void *(*fn)(void *), struct check_job *jobs, int threads)
+{
+    pthread_t tids[CHECK_THREADS];
+    int started[CHECK_THREADS];
+    int i;
+    for (i = 0; i < threads; i++)
     {
-        size_t* startx = l15;
-        for(; startx != NULL; startx = (size_t*)*startx)
+        started[i] = (pthread_create(&tids[i], NULL, fn, &jobs[i]) == 0);
+        if (!started[i])
+            fn(&jobs[i]);
+    }
+    for (i = 0; i < threads; i++)
+    {
+        if (started[i])
+            pthread_join(tids[i], NULL);
+    }
+}
+
+/*
+ * mm_checkheap_parallel - Check the heap and the lists with up to
+ * threads threads. Every free block is a known block boundary, so
+ * the lists are checked first and their blocks closest to evenly
+ * spaced addresses split the heap walk into segments. Return -1 if
+ * anything is wrong, 0 otherwise.
+ */
+int mm_checkheap_parallel(int threads)
+{
+    struct check_job jobs[CHECK_THREADS];
+    size_t *lists[CHECK_LISTS];
+    char *targets[CHECK_THREADS];
+    char *lo = (char *)mem_heap_lo();
+    char *epilogue = (char *)mem_heap_hi() + 1;
+    long free_listed = 0, free_walked = 0;
+    int errors = 0;
+    int i, k;
+    if (heap_listp == 0)
+        return 0;
+    if (threads < 1)
+        threads = 1;
+    if (threads > CHECK_THREADS)
+        threads = CHECK_THREADS;
+    lists[0] = l01; lists[1] = l02; lists[2] = l03; lists[3] = l04;
+    lists[4] = l05; lists[5] = l06; lists[6] = l07; lists[7] = l08;
+    lists[8] = l09; lists[9] = l10; lists[10] = l11; lists[11] = l12;
+    lists[12] = l13; lists[13] = l14; lists[14] = l15;
+#ifdef HOT_COLD
+    lists[15] = hot[0]; lists[16] = hot[1]; lists[17] = hot[2];
+    memcpy(&lists[15 + HOT_LISTS], cold, sizeof(cold));
+#endif /* def HOT_COLD */
+    for (k = 0; k < threads; k++)
+        targets[k] = lo + (size_t)(epilogue - lo) / threads * k;
+
+    /* Check the lists and find the checkpoints */
+    memset(jobs, 0, sizeof(jobs));
+    for (i = 0; i < threads; i++)
+    {
+        jobs[i].id = i;
+        jobs[i].threads = threads;
+        jobs[i].lists = lists;
+        jobs[i].targets = targets;
+    }
+    check_run(check_lists, jobs, threads);
+    targets[0] = heap_listp;
+    for (k = 1; k < threads; k++)
+    {
+        targets[k] = epilogue;
+        for (i = 0; i < threads; i++)
         {
-            cnt1 ++;
-            if (!in_heap(startx))
-            {
-                printf("Block Out Of Range Error!\n");
-                exit(0);
-            }
-            printf("The Current Block Is %p With Size %d\n", startx, GET_SIZE(HDRP(startx)));
-            if (GET_SIZE(HDRP(startx)) <= num14)
-            {
-                printf("Block Size Out Of Range Error!\n");
-            }
+            if (jobs[i].first[k] != NULL && jobs[i].first[k] < targets[k])
+                targets[k] = jobs[i].first[k];
         }
     }
-    printf("Free Blocks Number Is %d\n", cnt);
-    if (cnt != cnt1)
+
+    /* Walk the segments between the checkpoints */
+    for (i = 0; i < threads; i++)
+    {
+        jobs[i].start = targets[i];
+        jobs[i].end = (i + 1 < threads) ? targets[i + 1] : epilogue;
+    }
+    check_run(check_walk, jobs, threads);
+    for (i = 0; i < threads; i++)
+    {
+        free_listed += jobs[i].free_listed;
+        free_walked += jobs[i].free_walked;
+        errors += jobs[i].errors;
+    }
+    if (free_listed != free_walked)
     {
         printf("Free Blocks Numbers Match Error!\n");
-        exit(0);
+        errors ++;
     }
+    return errors ? -1 : 0;
 }
+#endif /* def PARALLEL_CHECK */
 
 /* 
  * extend_heap - Extend heap with free block and return its block pointer
@@ -769,6 +2057,11 @@ static void *coalesce(void *bp)
     size_t prev_alloc = PREVX(HDRP(bp));
     size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
     size_t size = GET_SIZE(HDRP(bp));
+#ifdef SIMULATE
+    /* the boundaries merged away, whose tags are dropped at the end */
+    void *gone_prev = (prev_alloc != 4) ? bp : NULL;
+    void *gone_next = !next_alloc ? NEXT_BLKP(bp) : NULL;
+#endif /* def SIMULATE */
     /* if prev_alloc == 4, the previous block is allocated */
     if ((prev_alloc == 4) && next_alloc) /* Case 1 */
     { 
@@ -806,6 +2099,12 @@ static void *coalesce(void *bp)
         bp = PREV_BLKP(bp);
         insertx(bp, size);
     }
+#ifdef SIMULATE
+    if (gone_prev != NULL)
+        sim_drop(gone_prev);
+    if (gone_next != NULL)
+        sim_drop(gone_next);
+#endif /* def SIMULATE */
     return bp;
 }
 
@@ -874,114 +2173,282 @@ static void insertx(void *bp, size_t asize)
     if (asize <= num01)
     {
         size_t *temp = (size_t *)(bp); //the head of the link list
-        *temp = (size_t)l01;
+        PUT_LINK(temp, l01);
         l01 = bp;
         return;
     }
     if (asize <= num02)
     {
         size_t *temp = (size_t *)(bp); //the head of the link list
-        *temp = (size_t)l02;
+        PUT_LINK(temp, l02);
         l02 = bp;
         return;
     }
     if (asize <= num03)
     {
         size_t *temp = (size_t *)(bp); //the head of the link list
-        *temp = (size_t)l03;
+        PUT_LINK(temp, l03);
         l03 = bp;
         return;
     }
     if (asize == num04)
     {
         size_t *temp = (size_t *)(bp); //the head of the link list
-        *temp = (size_t)l04;
+        PUT_LINK(temp, l04);
         l04 = bp;
         return;
     }
     if (asize == num05)
     {
         size_t *temp = (size_t *)(bp); //the head of the link list
-        *temp = (size_t)l05;
+        PUT_LINK(temp, l05);
         l05 = bp;
         return;
     }
     if (asize <= num06)
     {
         size_t *temp = (size_t *)(bp); //the head of the link list
-        *temp = (size_t)l06;
+        PUT_LINK(temp, l06);
         l06 = bp;
         return;
     }
     if (asize <= num07)
     {
         size_t *temp = (size_t *)(bp); //the head of the link list
-        *temp = (size_t)l07;
+        PUT_LINK(temp, l07);
         l07 = bp;
         return;
     }
     if (asize <= num08)
     {
         size_t *temp = (size_t *)(bp); //the head of the link list
-        *temp = (size_t)l08;
+        PUT_LINK(temp, l08);
         l08 = bp;
         return;
     }
     if (asize <= num09)
     {
         size_t *temp = (size_t *)(bp); //the head of the link list
-        *temp = (size_t)l09;
+        PUT_LINK(temp, l09);
         l09 = bp;
         return;
     }
     if (asize <= num10)
     {
         size_t *temp = (size_t *)(bp); //the head of the link list
-        *temp = (size_t)l10;
+        PUT_LINK(temp, l10);
         l10 = bp;
         return;
     }
     if (asize <= num11)
     {
         size_t *temp = (size_t *)(bp); //the head of the link list
-        *temp = (size_t)l11;
+        PUT_LINK(temp, l11);
         l11 = bp;
         return;
     }
     if (asize <= num12)
     {
         size_t *temp = (size_t *)(bp); //the head of the link list
-        *temp = (size_t)l12;
+        PUT_LINK(temp, l12);
         l12 = bp;
         return;
     }
+#ifdef HOT_COLD
+    if (hot_insert(bp, asize))
+        return;
+#endif /* def HOT_COLD */
     if (asize <= num13)
     {
         size_t *temp = (size_t *)(bp); //the head of the link list
-        *temp = (size_t)l13;
+        PUT_LINK(temp, l13);
         l13 = bp;
         return;
     }
     if (asize <= num14)
     {
         size_t *temp = (size_t *)(bp); //the head of the link list
-        *temp = (size_t)l14;
+        PUT_LINK(temp, l14);
         l14 = bp;
         return;
     }
     size_t *temp = (size_t *)(bp); //the head of the link list
-    *temp = (size_t)l15;
+    PUT_LINK(temp, l15);
     l15 = bp;
     return;
 }
 
+#ifdef HOT_COLD
+/*
+ * hot_index - Return which hot segment a size above num12 uses
+ */
+static int hot_index(size_t asize)
+{
+    if (asize <= num13)
+        return 0;
+    if (asize <= num14)
+        return 1;
+    return 2;
+}
+
+/*
+ * cold_index - Return the cold bucket of a size above num12: its
+ * power of two and the next COLD_SUB_BITS bits, the last bucket
+ * taking everything larger
+ */
+static int cold_index(size_t size)
+{
+    int e = 63 - __builtin_clzl(size);
+    if (e >= COLD_MIN_SHIFT + COLD_BUCKETS / COLD_SUB)
+        return COLD_BUCKETS - 1;
+    return (e - COLD_MIN_SHIFT) * COLD_SUB + (int)((size >> (e - COLD_SUB_BITS)) & (COLD_SUB - 1));
+}
+
+/*
+ * cold_insert - Push a block onto its cold bucket
+ */
+static void cold_insert(size_t *bp)
+{
+    int b = cold_index(GET_SIZE(HDRP(bp)));
+    PUT_LINK(bp, cold[b]);
+    cold[b] = bp;
+    cold_map |= (uint64_t)1 << b;
+}
+
+/*
+ * cold_delete - Remove a block from its cold bucket. Return 0 if it
+ * is not there.
+ */
+static int cold_delete(void *bp)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    size_t *prev = NULL;
+    size_t *now;
+    int b;
+    if (size <= num12)
+        return 0;
+    b = cold_index(size);
+    for (now = cold[b]; now != NULL; prev = now, now = GET_LINK(now))
+    {
+        if (now == bp)
+        {
+            if (prev == NULL)
+                cold[b] = GET_LINK(now);
+            else
+                PUT_LINK(prev, GET_LINK(now));
+            if (cold[b] == NULL)
+                cold_map &= ~((uint64_t)1 << b);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * cold_fit - Find a cold block that fits: the first fit in the bucket
+ * of asize, else the first block of the next bucket that is not
+ * empty, where every block fits.
+ */
+static void *cold_fit(size_t asize)
+{
+    int b = (asize <= num12) ? 0 : cold_index(asize);
+    uint64_t above;
+    size_t *now;
+    for (now = cold[b]; now != NULL; now = GET_LINK(now))
+    {
+        if (GET_SIZE(HDRP(now)) >= asize)
+            return now;
+    }
+    above = (b + 1 < COLD_BUCKETS) ? cold_map & (~(uint64_t)0 << (b + 1)) : 0;
+    if (above == 0)
+        return NULL;
+    return cold[__builtin_ctzll(above)];
+}
+
+/*
+ * hot_insert - Push a large block onto its hot segment. When the
+ * segment grows past HOT_MAX, its oldest block turns cold.
+ * Return 0 if the block is not large enough to have a hot segment.
+ */
+static int hot_insert(void *bp, size_t asize)
+{
+    int h;
+    size_t *prev, *now;
+    if (asize <= num12)
+        return 0;
+    h = hot_index(asize);
+    PUT_LINK(bp, hot[h]);
+    hot[h] = bp;
+    if (++hot_count[h] <= HOT_MAX)
+        return 1;
+    /* the oldest block is the last one */
+    prev = hot[h];
+    now = GET_LINK(prev);
+    while (GET_LINK(now) != NULL)
+    {
+        prev = now;
+        now = GET_LINK(now);
+    }
+    PUT_LINK(prev, NULL);
+    hot_count[h] --;
+    cold_insert(now);
+    return 1;
+}
+
+/*
+ * hot_delete - Remove a block from the hot segment of its size.
+ * Return 0 if it is not there.
+ */
+static int hot_delete(void *bp)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    size_t *prev = NULL;
+    size_t *now;
+    int h;
+    if (size <= num12)
+        return 0;
+    h = hot_index(size);
+    for (now = hot[h]; now != NULL; prev = now, now = GET_LINK(now))
+    {
+        if (now == bp)
+        {
+            if (prev == NULL)
+                hot[h] = GET_LINK(now);
+            else
+                PUT_LINK(prev, GET_LINK(now));
+            hot_count[h] --;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * hot_fit - Find the first block in the hot segments that fits
+ */
+static void *hot_fit(size_t asize)
+{
+    int h = (asize <= num12) ? 0 : hot_index(asize);
+    for (; h < HOT_LISTS; h++)
+    {
+        size_t *now;
+        for (now = hot[h]; now != NULL; now = GET_LINK(now))
+        {
+            if (GET_SIZE(HDRP(now)) >= asize)
+                return now;
+        }
+    }
+    return NULL;
+}
+#endif /* def HOT_COLD */
+
 /* 
  * deletex - delete a block with fixed size in lists
  */
 static void deletex(void *bp, size_t asize)
 {
     size_t *nowbp = (size_t *)bp;
-    size_t *nextk = (size_t *)(*nowbp);
+    size_t *nextk = GET_LINK(nowbp);
     /* find the list that contains the block based on the block size */
     if (asize <= num01)
     {
@@ -998,14 +2465,14 @@ static void deletex(void *bp, size_t asize)
         }
         while (nowx)
         {
-            if ((size_t)*nowx == (size_t)nowbp)
+            if (GET_LINK(nowx) == nowbp)
             {
-                *nowx = (size_t)(nextk);
+                PUT_LINK(nowx, nextk);
                 return;
             }
             else
             {
-                nowx = (size_t *)*nowx;
+                nowx = GET_LINK(nowx);
             }
         }
     }
@@ -1024,14 +2491,14 @@ static void deletex(void *bp, size_t asize)
         }
         while (nowx)
         {
-            if ((size_t)*nowx == (size_t)nowbp)
+            if (GET_LINK(nowx) == nowbp)
             {
-                *nowx = (size_t)(nextk);
+                PUT_LINK(nowx, nextk);
                 return;
             }
             else
             {
-                nowx = (size_t *)*nowx;
+                nowx = GET_LINK(nowx);
             }
         }
     }
@@ -1050,14 +2517,14 @@ static void deletex(void *bp, size_t asize)
         }
         while (nowx)
         {
-            if ((size_t)*nowx == (size_t)nowbp)
+            if (GET_LINK(nowx) == nowbp)
             {
-                *nowx = (size_t)(nextk);
+                PUT_LINK(nowx, nextk);
                 return;
             }
             else
             {
-                nowx = (size_t *)*nowx;
+                nowx = GET_LINK(nowx);
             }
         }
     }
@@ -1076,14 +2543,14 @@ static void deletex(void *bp, size_t asize)
         }
         while (nowx)
         {
-            if ((size_t)*nowx == (size_t)nowbp)
+            if (GET_LINK(nowx) == nowbp)
             {
-                *nowx = (size_t)(nextk);
+                PUT_LINK(nowx, nextk);
                 return;
             }
             else
             {
-                nowx = (size_t *)*nowx;
+                nowx = GET_LINK(nowx);
             }
         }
     }
@@ -1102,14 +2569,14 @@ static void deletex(void *bp, size_t asize)
         }
         while (nowx)
         {
-            if ((size_t)*nowx == (size_t)nowbp)
+            if (GET_LINK(nowx) == nowbp)
             {
-                *nowx = (size_t)(nextk);
+                PUT_LINK(nowx, nextk);
                 return;
             }
             else
             {
-                nowx = (size_t *)*nowx;
+                nowx = GET_LINK(nowx);
             }
         }
     }
@@ -1128,14 +2595,14 @@ static void deletex(void *bp, size_t asize)
         }
         while (nowx)
         {
-            if ((size_t)*nowx == (size_t)nowbp)
+            if (GET_LINK(nowx) == nowbp)
             {
-                *nowx = (size_t)(nextk);
+                PUT_LINK(nowx, nextk);
                 return;
             }
             else
             {
-                nowx = (size_t *)*nowx;
+                nowx = GET_LINK(nowx);
             }
         }
     }
@@ -1154,14 +2621,14 @@ static void deletex(void *bp, size_t asize)
         }
         while (nowx)
         {
-            if ((size_t)*nowx == (size_t)nowbp)
+            if (GET_LINK(nowx) == nowbp)
             {
-                *nowx = (size_t)(nextk);
+                PUT_LINK(nowx, nextk);
                 return;
             }
             else
             {
-                nowx = (size_t *)*nowx;
+                nowx = GET_LINK(nowx);
             }
         }
     }
@@ -1180,14 +2647,14 @@ static void deletex(void *bp, size_t asize)
         }
         while (nowx)
         {
-            if ((size_t)*nowx == (size_t)nowbp)
+            if (GET_LINK(nowx) == nowbp)
             {
-                *nowx = (size_t)(nextk);
+                PUT_LINK(nowx, nextk);
                 return;
             }
             else
             {
-                nowx = (size_t *)*nowx;
+                nowx = GET_LINK(nowx);
             }
         }
     }
@@ -1206,14 +2673,14 @@ static void deletex(void *bp, size_t asize)
         }
         while (nowx)
         {
-            if ((size_t)*nowx == (size_t)nowbp)
+            if (GET_LINK(nowx) == nowbp)
             {
-                *nowx = (size_t)(nextk);
+                PUT_LINK(nowx, nextk);
                 return;
             }
             else
             {
-                nowx = (size_t *)*nowx;
+                nowx = GET_LINK(nowx);
             }
         }
     }
@@ -1232,14 +2699,14 @@ static void deletex(void *bp, size_t asize)
         }
         while (nowx)
         {
-            if ((size_t)*nowx == (size_t)nowbp)
+            if (GET_LINK(nowx) == nowbp)
             {
-                *nowx = (size_t)(nextk);
+                PUT_LINK(nowx, nextk);
                 return;
             }
             else
             {
-                nowx = (size_t *)*nowx;
+                nowx = GET_LINK(nowx);
             }
         }
     }
@@ -1258,14 +2725,14 @@ static void deletex(void *bp, size_t asize)
         }
         while (nowx)
         {
-            if ((size_t)*nowx == (size_t)nowbp)
+            if (GET_LINK(nowx) == nowbp)
             {
-                *nowx = (size_t)(nextk);
+                PUT_LINK(nowx, nextk);
                 return;
             }
             else
             {
-                nowx = (size_t *)*nowx;
+                nowx = GET_LINK(nowx);
             }
         }
     }
@@ -1284,17 +2751,22 @@ static void deletex(void *bp, size_t asize)
         }
         while (nowx)
         {
-            if ((size_t)*nowx == (size_t)nowbp)
+            if (GET_LINK(nowx) == nowbp)
             {
-                *nowx = (size_t)(nextk);
+                PUT_LINK(nowx, nextk);
                 return;
             }
             else
             {
-                nowx = (size_t *)*nowx;
+                nowx = GET_LINK(nowx);
             }
         }
     }
+#ifdef HOT_COLD
+    /* deletex runs before the tags change, so the header has the size */
+    if (hot_delete(bp) || cold_delete(bp))
+        return;
+#endif /* def HOT_COLD */
     if (asize <= num13)
     {
         size_t *nowx = l13;
@@ -1310,14 +2782,14 @@ static void deletex(void *bp, size_t asize)
         }
         while (nowx)
         {
-            if ((size_t)*nowx == (size_t)nowbp)
+            if (GET_LINK(nowx) == nowbp)
             {
-                *nowx = (size_t)(nextk);
+                PUT_LINK(nowx, nextk);
                 return;
             }
             else
             {
-                nowx = (size_t *)*nowx;
+                nowx = GET_LINK(nowx);
             }
         }
     }
@@ -1336,14 +2808,14 @@ static void deletex(void *bp, size_t asize)
         }
         while (nowx)
         {
-            if ((size_t)*nowx == (size_t)nowbp)
+            if (GET_LINK(nowx) == nowbp)
             {
-                *nowx = (size_t)(nextk);
+                PUT_LINK(nowx, nextk);
                 return;
             }
             else
             {
-                nowx = (size_t *)*nowx;
+                nowx = GET_LINK(nowx);
             }
         }
     }
@@ -1360,14 +2832,14 @@ static void deletex(void *bp, size_t asize)
     }
     while (nowx)
     {
-        if ((size_t)*nowx == (size_t)nowbp)
+        if (GET_LINK(nowx) == nowbp)
         {
-            *nowx = (size_t)(nextk);
+            PUT_LINK(nowx, nextk);
             return;
         }
         else
         {
-            nowx = (size_t *)*nowx;
+            nowx = GET_LINK(nowx);
         }
     }
     return;
@@ -1396,9 +2868,9 @@ static void *find_fit(size_t asize)
                 }
                 else
                 {
-                    if (*now_list_start != (size_t)NULL)
+                    if (GET_LINK(now_list_start) != NULL)
                     {
-                        now_list_start = (size_t *)*(now_list_start);
+                        now_list_start = GET_LINK(now_list_start);
                     }
                     else
                     {
@@ -1423,9 +2895,9 @@ static void *find_fit(size_t asize)
                 }
                 else
                 {
-                    if (*now_list_start != (size_t)NULL)
+                    if (GET_LINK(now_list_start) != NULL)
                     {
-                        now_list_start = (size_t *)*(now_list_start);
+                        now_list_start = GET_LINK(now_list_start);
                     }
                     else
                     {
@@ -1450,9 +2922,9 @@ static void *find_fit(size_t asize)
                 }
                 else
                 {
-                    if (*now_list_start != (size_t)NULL)
+                    if (GET_LINK(now_list_start) != NULL)
                     {
-                        now_list_start = (size_t *)*(now_list_start);
+                        now_list_start = GET_LINK(now_list_start);
                     }
                     else
                     {
@@ -1477,9 +2949,9 @@ static void *find_fit(size_t asize)
                 }
                 else
                 {
-                    if (*now_list_start != (size_t)NULL)
+                    if (GET_LINK(now_list_start) != NULL)
                     {
-                        now_list_start = (size_t *)*(now_list_start);
+                        now_list_start = GET_LINK(now_list_start);
                     }
                     else
                     {
@@ -1504,9 +2976,9 @@ static void *find_fit(size_t asize)
                 }
                 else
                 {
-                    if (*now_list_start != (size_t)NULL)
+                    if (GET_LINK(now_list_start) != NULL)
                     {
-                        now_list_start = (size_t *)*(now_list_start);
+                        now_list_start = GET_LINK(now_list_start);
                     }
                     else
                     {
@@ -1531,9 +3003,9 @@ static void *find_fit(size_t asize)
                 }
                 else
                 {
-                    if (*now_list_start != (size_t)NULL)
+                    if (GET_LINK(now_list_start) != NULL)
                     {
-                        now_list_start = (size_t *)*(now_list_start);
+                        now_list_start = GET_LINK(now_list_start);
                     }
                     else
                     {
@@ -1558,9 +3030,9 @@ static void *find_fit(size_t asize)
                 }
                 else
                 {
-                    if (*now_list_start != (size_t)NULL)
+                    if (GET_LINK(now_list_start) != NULL)
                     {
-                        now_list_start = (size_t *)*(now_list_start);
+                        now_list_start = GET_LINK(now_list_start);
                     }
                     else
                     {
@@ -1585,9 +3057,9 @@ static void *find_fit(size_t asize)
                 }
                 else
                 {
-                    if (*now_list_start != (size_t)NULL)
+                    if (GET_LINK(now_list_start) != NULL)
                     {
-                        now_list_start = (size_t *)*(now_list_start);
+                        now_list_start = GET_LINK(now_list_start);
                     }
                     else
                     {
@@ -1612,9 +3084,9 @@ static void *find_fit(size_t asize)
                 }
                 else
                 {
-                    if (*now_list_start != (size_t)NULL)
+                    if (GET_LINK(now_list_start) != NULL)
                     {
-                        now_list_start = (size_t *)*(now_list_start);
+                        now_list_start = GET_LINK(now_list_start);
                     }
                     else
                     {
@@ -1639,9 +3111,9 @@ static void *find_fit(size_t asize)
                 }
                 else
                 {
-                    if (*now_list_start != (size_t)NULL)
+                    if (GET_LINK(now_list_start) != NULL)
                     {
-                        now_list_start = (size_t *)*(now_list_start);
+                        now_list_start = GET_LINK(now_list_start);
                     }
                     else
                     {
@@ -1666,9 +3138,9 @@ static void *find_fit(size_t asize)
                 }
                 else
                 {
-                    if (*now_list_start != (size_t)NULL)
+                    if (GET_LINK(now_list_start) != NULL)
                     {
-                        now_list_start = (size_t *)*(now_list_start);
+                        now_list_start = GET_LINK(now_list_start);
                     }
                     else
                     {
@@ -1693,9 +3165,9 @@ static void *find_fit(size_t asize)
                 }
                 else
                 {
-                    if (*now_list_start != (size_t)NULL)
+                    if (GET_LINK(now_list_start) != NULL)
                     {
-                        now_list_start = (size_t *)*(now_list_start);
+                        now_list_start = GET_LINK(now_list_start);
                     }
                     else
                     {
@@ -1705,6 +3177,10 @@ static void *find_fit(size_t asize)
             }
         }
     }
+#ifdef HOT_COLD
+    if ((bp = hot_fit(asize)) != NULL || (bp = cold_fit(asize)) != NULL)
+        return bp;
+#endif /* def HOT_COLD */
     if (asize <= num13)
     {
         size_t *bp = l13;
@@ -1720,9 +3196,9 @@ static void *find_fit(size_t asize)
                 }
                 else
                 {
-                    if (*now_list_start != (size_t)NULL)
+                    if (GET_LINK(now_list_start) != NULL)
                     {
-                        now_list_start = (size_t *)*(now_list_start);
+                        now_list_start = GET_LINK(now_list_start);
                     }
                     else
                     {
@@ -1747,9 +3223,9 @@ static void *find_fit(size_t asize)
                 }
                 else
                 {
-                    if (*now_list_start != (size_t)NULL)
+                    if (GET_LINK(now_list_start) != NULL)
                     {
-                        now_list_start = (size_t *)*(now_list_start);
+                        now_list_start = GET_LINK(now_list_start);
                     }
                     else
                     {
@@ -1775,9 +3251,9 @@ static void *find_fit(size_t asize)
         }
         else
         {
-            if (*now_list_start != (size_t)NULL)
+            if (GET_LINK(now_list_start) != NULL)
             {
-                now_list_start = (size_t *)*(now_list_start);
+                now_list_start = GET_LINK(now_list_start);
             }
             else
             {
@@ -1787,3 +3263,273 @@ static void *find_fit(size_t asize)
     }
     return NULL;
 }
+
+#ifdef SIMULATE
+/*
+ * The tags of one block boundary. Records never move, so a link is
+ * the index of the next block's record and a walk along a list
+ * follows indices instead of hashing every block. Record 0 is never
+ * used and stands for NULL.
+ */
+struct sim_tag
+{
+    unsigned int key;  /* boundary offset / 8 from SIM_BASE, 0 when free */
+    unsigned int ftr;  /* footer of the block before */
+    unsigned int hdr;  /* header of the block */
+    unsigned int link; /* record of the next block in its list */
+};
+
+/* a slot of the open-addressing index from key to record */
+struct sim_slot
+{
+    unsigned int key;
+    unsigned int tag;
+};
+
+/* the break of the virtual heap */
+static char *sim_brk = SIM_BASE;
+/* the records, and the free ones chained through their links */
+static struct sim_tag *sim_tags = NULL;
+static unsigned int sim_ntags = 0;
+static unsigned int sim_maxtags = 0;
+static unsigned int sim_free_tag = 0;
+/* the index, at most 3/4 full */
+static struct sim_slot *sim_slots = NULL;
+static size_t sim_size = 0;
+static size_t sim_count = 0;
+/* the record looked up last and the one its link led to */
+static unsigned int sim_last = 0;
+static unsigned int sim_next = 0;
+
+/*
+ * sim_map - Map size zeroed bytes, exit on error
+ */
+static void *sim_map(size_t size)
+{
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+    {
+        printf("Simulation Tag Table Map Error!\n");
+        exit(0);
+    }
+    return p;
+}
+
+/*
+ * sim_home - Return the index slot a key hashes to
+ */
+static size_t sim_home(unsigned int key)
+{
+    return (size_t)(((uint64_t)key * 0x9E3779B97F4A7C15UL) >> 32) & (sim_size - 1);
+}
+
+/*
+ * sim_grow - Double the index and insert every key again
+ */
+static void sim_grow(void)
+{
+    struct sim_slot *old = sim_slots;
+    size_t old_size = sim_size;
+    size_t i;
+    sim_size = old_size * 2;
+    sim_slots = sim_map(sim_size * sizeof(struct sim_slot));
+    for (i = 0; i < old_size; i++)
+    {
+        if (old[i].key != 0)
+        {
+            size_t j = sim_home(old[i].key);
+            while (sim_slots[j].key != 0)
+                j = (j + 1) & (sim_size - 1);
+            sim_slots[j] = old[i];
+        }
+    }
+    munmap(old, old_size * sizeof(struct sim_slot));
+}
+
+/*
+ * sim_new_tag - Return an empty record for key
+ */
+static unsigned int sim_new_tag(unsigned int key)
+{
+    unsigned int t = sim_free_tag;
+    if (t != 0)
+    {
+        sim_free_tag = sim_tags[t].link;
+    }
+    else
+    {
+        if (sim_ntags == sim_maxtags)
+        {
+            struct sim_tag *tags = sim_map((size_t)sim_maxtags * 2 * sizeof(struct sim_tag));
+            memcpy(tags, sim_tags, (size_t)sim_ntags * sizeof(struct sim_tag));
+            munmap(sim_tags, (size_t)sim_maxtags * sizeof(struct sim_tag));
+            sim_tags = tags;
+            sim_maxtags *= 2;
+        }
+        t = sim_ntags ++;
+    }
+    sim_tags[t].key = key;
+    sim_tags[t].ftr = 0;
+    sim_tags[t].hdr = 0;
+    sim_tags[t].link = 0;
+    return t;
+}
+
+/*
+ * sim_find - Return the record of a boundary, adding an empty one
+ * when add is set, or 0
+ */
+static unsigned int sim_find(unsigned int key, int add)
+{
+    size_t i;
+    if (sim_tags[sim_last].key == key)
+        return sim_last;
+    if (sim_tags[sim_next].key == key)
+        return sim_last = sim_next;
+    for (i = sim_home(key); sim_slots[i].key != 0; i = (i + 1) & (sim_size - 1))
+    {
+        if (sim_slots[i].key == key)
+            return sim_last = sim_slots[i].tag;
+    }
+    if (!add)
+        return 0;
+    if ((sim_count + 1) * 4 > sim_size * 3)
+    {
+        sim_grow();
+        return sim_find(key, add);
+    }
+    sim_count ++;
+    sim_slots[i].key = key;
+    sim_slots[i].tag = sim_new_tag(key);
+    return sim_last = sim_slots[i].tag;
+}
+
+/*
+ * sim_key - Return the key of the boundary a tag at p belongs to:
+ * a header at bp - 4 and a footer at bp - 8 both round up to bp
+ */
+static unsigned int sim_key(const void *p)
+{
+    return (unsigned int)(((const char *)p - SIM_BASE + DSIZE) / DSIZE);
+}
+
+/*
+ * sim_link_key - Return the key of block bp
+ */
+static unsigned int sim_link_key(const void *bp)
+{
+    return (unsigned int)(((const char *)bp - SIM_BASE) / DSIZE);
+}
+
+static unsigned int sim_get(const void *p)
+{
+    unsigned int t = sim_find(sim_key(p), 0);
+    return (((size_t)p & WSIZE) != 0) ? sim_tags[t].hdr : sim_tags[t].ftr;
+}
+
+static void sim_put(void *p, unsigned int val)
+{
+    unsigned int t = sim_find(sim_key(p), 1);
+    if (((size_t)p & WSIZE) != 0)
+        sim_tags[t].hdr = val;
+    else
+        sim_tags[t].ftr = val;
+}
+
+static size_t *sim_get_link(const void *bp)
+{
+    unsigned int t = sim_find(sim_link_key(bp), 0);
+    if (sim_tags[t].link == 0)
+        return NULL;
+    sim_next = sim_tags[t].link;
+    return (size_t *)(SIM_BASE + (size_t)sim_tags[sim_next].key * DSIZE);
+}
+
+static void sim_put_link(void *bp, void *val)
+{
+    unsigned int next = (val == NULL) ? 0 : sim_find(sim_link_key(val), 1);
+    unsigned int t = sim_find(sim_link_key(bp), 1);
+    sim_tags[t].link = next;
+}
+
+/*
+ * sim_drop - Forget the boundary at bp once coalescing merged it
+ * away: free its record and shift back the index slots probed past it
+ */
+static void sim_drop(void *bp)
+{
+    unsigned int key = sim_link_key(bp);
+    size_t i, j;
+    for (i = sim_home(key); sim_slots[i].key != key; i = (i + 1) & (sim_size - 1))
+    {
+        if (sim_slots[i].key == 0)
+            return;
+    }
+    sim_tags[sim_slots[i].tag].key = 0;
+    sim_tags[sim_slots[i].tag].link = sim_free_tag;
+    sim_free_tag = sim_slots[i].tag;
+    sim_slots[i].key = 0;
+    sim_count --;
+    for (j = (i + 1) & (sim_size - 1); sim_slots[j].key != 0; j = (j + 1) & (sim_size - 1))
+    {
+        size_t home = sim_home(sim_slots[j].key);
+        /* the slot at j may move to i if i lies between its home and j */
+        if (((j - home) & (sim_size - 1)) >= ((j - i) & (sim_size - 1)))
+        {
+            sim_slots[i] = sim_slots[j];
+            sim_slots[j].key = 0;
+            i = j;
+        }
+    }
+}
+
+/*
+ * sim_reset - Drop the virtual heap and all of its metadata
+ */
+static void sim_reset(void)
+{
+    if (sim_tags != NULL)
+    {
+        munmap(sim_tags, (size_t)sim_maxtags * sizeof(struct sim_tag));
+        munmap(sim_slots, sim_size * sizeof(struct sim_slot));
+    }
+    sim_maxtags = SIM_MIN_TAGS;
+    sim_tags = sim_map((size_t)sim_maxtags * sizeof(struct sim_tag));
+    sim_ntags = 1;
+    sim_free_tag = 0;
+    sim_size = SIM_MIN_TAGS;
+    sim_slots = sim_map(sim_size * sizeof(struct sim_slot));
+    sim_count = 0;
+    sim_last = 0;
+    sim_next = 0;
+    sim_brk = SIM_BASE;
+}
+
+/*
+ * sim_sbrk - Extend the virtual heap by incr bytes without committing
+ * any memory, return the old break or (void *)-1 on error.
+ */
+void *sim_sbrk(int incr)
+{
+    char *old_brk = sim_brk;
+    if (incr < 0 || (size_t)(sim_brk + incr - SIM_BASE) > SIM_MAX_HEAP)
+        return (void *)-1;
+    sim_brk += incr;
+    return old_brk;
+}
+
+void *sim_heap_lo(void)
+{
+    return SIM_BASE;
+}
+
+void *sim_heap_hi(void)
+{
+    return sim_brk - 1;
+}
+
+size_t sim_heapsize(void)
+{
+    return (size_t)(sim_brk - SIM_BASE);
+}
+#endif /* def SIMULATE */
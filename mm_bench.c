@@ -0,0 +1,364 @@
+/*
+ * mm_bench.c
+ *
+ * Header Comment:
+ * This program simulates a request server on top of the allocator
+ * to measure tail latency rather than throughput.
+ * Every worker thread gets requests at fixed intended start times
+ * (open loop), so a stalled request delays the ones behind it
+ * instead of hiding them. Each request allocates an arena-like
+ * burst of small blocks, frees them at the end, and may insert a
+ * long-lived object into a shared cache, evicting an old one when
+ * the cache is full.
+ *
+ * Two latency histograms are reported: the service time measured
+ * from the actual start, and the response time measured from the
+ * intended start, which is corrected for coordinated omission.
+ *
+ * The burst and the cache inserts allocate from two distinct call
+ * sites, which the allocator sees through mm_malloc_at when it is
+ * built with -DCALLSITE_BINS.
+ *
+ * Build it with memlib.c and mm_allocator.c, adding -DTRANSFER_CACHE,
+ * -DCALLSITE_BINS, -DSMALL_ARENAS, -DPRESSURE_PURGE or -DHOT_COLD to
+ * compare allocator configurations. With -DPRESSURE_PURGE the pressure
+ * is read from the system's cgroup and PSI files:
+ *     gcc -O2 -DDRIVER -o mm_bench mm_bench.c mm_allocator.c memlib.c -lpthread
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "mm_ext.h"
+
+/* the histogram: HIST_SUB linear buckets in every power of two */
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (64 * HIST_SUB)
+
+/* the shape of a request */
+#define BURST_MIN 4
+#define BURST_MAX 64
+#define BURST_SIZE 512
+#define CACHE_SLOTS 4096
+#define CACHE_SIZE 4096
+#define CACHE_INSERT 8 /* one request in CACHE_INSERT inserts */
+
+/*
+ * A worker sleeps until SPIN_NS before the intended start and spins
+ * the rest, as nanosleep can wake up to the 50us timer slack late and
+ * that delay would be charged to the allocator.
+ */
+#define SPIN_NS 200000
+
+struct hist
+{
+    unsigned long count[HIST_BUCKETS];
+    unsigned long total;
+    unsigned long max;
+};
+
+struct worker
+{
+    pthread_t tid;
+    int id;
+    long requests;
+    long interval;       /* nanoseconds between intended starts */
+    struct timespec start;
+    struct hist service;
+    struct hist response;
+};
+
+/* the allocator is a single heap, so all calls go through this lock */
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+/* the long-lived objects shared by all workers */
+static void *cache[CACHE_SLOTS];
+/* the call sites of the two kinds of allocation, only their addresses matter */
+static const char burst_site;
+static const char cache_site;
+
+/*
+ * bench_heapsize - Return the heap size, arenas included
+ */
+static size_t bench_heapsize(void)
+{
+#ifdef SMALL_ARENAS
+    return mem_heapsize() + mm_arena_bytes();
+#else
+    return mem_heapsize();
+#endif
+}
+
+/*
+ * now_ns - Return the monotonic time in nanoseconds
+ */
+static long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/*
+ * hist_index - Return the bucket of value v, exact below HIST_SUB
+ * and with HIST_SUB_BITS significant bits above.
+ */
+static int hist_index(unsigned long v)
+{
+    int e;
+    if (v < HIST_SUB)
+        return (int)v;
+    e = 63 - __builtin_clzl(v) - HIST_SUB_BITS;
+    return (e + 1) * HIST_SUB + (int)((v >> e) - HIST_SUB);
+}
+
+/*
+ * hist_value - Return the largest value that falls in bucket i
+ */
+static unsigned long hist_value(int i)
+{
+    int e = i / HIST_SUB;
+    unsigned long sub = i % HIST_SUB;
+    if (e == 0)
+        return sub;
+    return ((HIST_SUB + sub + 1) << (e - 1)) - 1;
+}
+
+static void hist_add(struct hist *h, unsigned long v)
+{
+    h->count[hist_index(v)] ++;
+    h->total ++;
+    if (v > h->max)
+        h->max = v;
+}
+
+static void hist_merge(struct hist *to, const struct hist *from)
+{
+    int i;
+    for (i = 0; i < HIST_BUCKETS; i++)
+        to->count[i] += from->count[i];
+    to->total += from->total;
+    if (from->max > to->max)
+        to->max = from->max;
+}
+
+/*
+ * hist_percentile - Return the value at percentile p of h
+ */
+static unsigned long hist_percentile(const struct hist *h, double p)
+{
+    unsigned long want = (unsigned long)(p / 100.0 * h->total + 0.5);
+    unsigned long seen = 0;
+    int i;
+    if (want == 0)
+        want = 1;
+    for (i = 0; i < HIST_BUCKETS; i++)
+    {
+        seen += h->count[i];
+        if (seen >= want)
+            return hist_value(i) < h->max ? hist_value(i) : h->max;
+    }
+    return h->max;
+}
+
+static void hist_print(const char *name, const struct hist *h)
+{
+    static const double pct[] = {50, 90, 99, 99.9, 99.99};
+    int i;
+    printf("%-9s", name);
+    for (i = 0; i < 5; i++)
+        printf(" p%-5g %9.2fus", pct[i], hist_percentile(h, pct[i]) / 1000.0);
+    printf(" max %9.2fus\n", h->max / 1000.0);
+}
+
+static void *bench_malloc(size_t size, const void *site)
+{
+    void *p;
+    pthread_mutex_lock(&heap_lock);
+#ifdef CALLSITE_BINS
+    p = mm_malloc_at(size, (void *)site);
+#else
+    (void)site;
+    p = mm_malloc(size);
+#endif
+    pthread_mutex_unlock(&heap_lock);
+    return p;
+}
+
+static void bench_free(void *p)
+{
+    pthread_mutex_lock(&heap_lock);
+    mm_free(p);
+    pthread_mutex_unlock(&heap_lock);
+}
+
+/*
+ * serve - Run one request: an arena-like burst of small blocks
+ * that are all freed at the end, and sometimes a cache insert.
+ */
+static void serve(unsigned int *seed)
+{
+    void *burst[BURST_MAX];
+    int n = BURST_MIN + rand_r(seed) % (BURST_MAX - BURST_MIN + 1);
+    int i;
+    for (i = 0; i < n; i++)
+    {
+        size_t size = 1 + rand_r(seed) % BURST_SIZE;
+        burst[i] = bench_malloc(size, &burst_site);
+        if (burst[i] != NULL)
+            memset(burst[i], i, size);
+    }
+    if (rand_r(seed) % CACHE_INSERT == 0)
+    {
+        size_t size = 1 + rand_r(seed) % CACHE_SIZE;
+        void *obj = bench_malloc(size, &cache_site);
+        void *old;
+        if (obj != NULL)
+            memset(obj, 0, size);
+        /* take the slot's old object out before freeing it */
+        old = __sync_lock_test_and_set(&cache[rand_r(seed) % CACHE_SLOTS], obj);
+        if (old != NULL)
+            bench_free(old);
+    }
+    for (i = 0; i < n; i++)
+    {
+        if (burst[i] != NULL)
+            bench_free(burst[i]);
+    }
+}
+
+/*
+ * work - Serve requests at fixed intended start times, waiting when
+ * early and starting at once when late.
+ */
+static void *work(void *arg)
+{
+    struct worker *w = arg;
+    unsigned int seed = 12345 + w->id;
+    long start = w->start.tv_sec * 1000000000L + w->start.tv_nsec;
+    long i;
+    for (i = 0; i < w->requests; i++)
+    {
+        long intended = start + i * w->interval;
+        long begin = now_ns();
+        long end;
+        while (begin < intended)
+        {
+            if (intended - begin > SPIN_NS)
+            {
+                long wait = intended - begin - SPIN_NS;
+                struct timespec ts;
+                ts.tv_sec = wait / 1000000000L;
+                ts.tv_nsec = wait % 1000000000L;
+                nanosleep(&ts, NULL);
+            }
+            begin = now_ns();
+        }
+        serve(&seed);
+        end = now_ns();
+        hist_add(&w->service, end - begin);
+        hist_add(&w->response, end - intended);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    int threads = 4;
+    long rate = 100000;
+    long requests = 200000;
+    struct worker *workers;
+    struct hist service, response;
+    long start, elapsed;
+    int opt, i;
+    while ((opt = getopt(argc, argv, "t:r:n:")) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+            threads = atoi(optarg);
+            break;
+        case 'r':
+            rate = atol(optarg);
+            break;
+        case 'n':
+            requests = atol(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-t threads] [-r requests/s] [-n requests]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (threads <= 0 || rate <= 0 || requests <= 0)
+    {
+        fprintf(stderr, "Arguments Must Be Positive Error!\n");
+        return 1;
+    }
+    /* every worker needs at least one request */
+    if (threads > requests)
+        threads = (int)requests;
+
+    mem_init();
+    if (mm_init() < 0)
+    {
+        fprintf(stderr, "Heap Initialize Error!\n");
+        return 1;
+    }
+#ifdef PRESSURE_PURGE
+    mm_pressure_start(NULL, NULL);
+#endif
+    workers = calloc(threads, sizeof(struct worker));
+    start = now_ns() + 1000000;
+    for (i = 0; i < threads; i++)
+    {
+        workers[i].id = i;
+        /* the first workers take the remainder */
+        workers[i].requests = requests / threads + (i < requests % threads);
+        /* each worker serves its share of the total rate */
+        workers[i].interval = 1000000000L * threads / rate;
+        workers[i].start.tv_sec = start / 1000000000L;
+        workers[i].start.tv_nsec = start % 1000000000L;
+        pthread_create(&workers[i].tid, NULL, work, &workers[i]);
+    }
+    memset(&service, 0, sizeof(service));
+    memset(&response, 0, sizeof(response));
+    for (i = 0; i < threads; i++)
+    {
+        pthread_join(workers[i].tid, NULL);
+        hist_merge(&service, &workers[i].service);
+        hist_merge(&response, &workers[i].response);
+    }
+    elapsed = now_ns() - start;
+#ifdef PRESSURE_PURGE
+    mm_pressure_stop();
+#endif
+
+    printf("Configuration:");
+#ifdef TRANSFER_CACHE
+    printf(" TRANSFER_CACHE");
+#endif
+#ifdef CALLSITE_BINS
+    printf(" CALLSITE_BINS");
+#endif
+#ifdef SMALL_ARENAS
+    printf(" SMALL_ARENAS");
+#endif
+#ifdef PRESSURE_PURGE
+    printf(" PRESSURE_PURGE");
+#endif
+#ifdef HOT_COLD
+    printf(" HOT_COLD");
+#endif
+    printf("\n");
+    printf("Threads %d, Target %ld req/s, Achieved %.0f req/s, Heap %zu bytes\n",
+           threads, rate, service.total * 1e9 / elapsed, bench_heapsize());
+    hist_print("Service", &service);
+    hist_print("Response", &response);
+    free(workers);
+    return 0;
+}
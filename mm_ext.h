@@ -0,0 +1,72 @@
+/*
+ * mm_ext.h
+ *
+ * Header Comment:
+ * Interfaces of mm_allocator.c beyond the ones the driver's mm.h
+ * declares. Every group is only compiled in when mm_allocator.c is
+ * built with the flag named above it.
+ */
+#ifndef MM_EXT_H
+#define MM_EXT_H
+
+#include <stddef.h>
+
+#ifdef SIGNAL_POOL
+/*
+ * Signal-safe pool: slots of at most 256 bytes from a pool reserved
+ * at build time, safe to take and give back from a signal handler.
+ * Malloc returns NULL when the pool is used up, and free ignores
+ * pointers that are not the start of a slot.
+ */
+void *mm_malloc_signal_safe(size_t size);
+void mm_free_signal_safe(void *ptr);
+#endif /* def SIGNAL_POOL */
+
+#ifdef SIMULATE
+/*
+ * Simulation mode: the heap is a range of virtual addresses that
+ * must never be dereferenced. These take the place of mem_sbrk,
+ * mem_heap_lo, mem_heap_hi and mem_heapsize from memlib.h.
+ */
+void *sim_sbrk(int incr);
+void *sim_heap_lo(void);
+void *sim_heap_hi(void);
+size_t sim_heapsize(void);
+#endif /* def SIMULATE */
+
+#ifdef CALLSITE_BINS
+/*
+ * Call-site bins: malloc on behalf of an explicit call site, for
+ * wrappers whose own return address would hide the real caller.
+ */
+void *mm_malloc_at(size_t size, void *site);
+#endif /* def CALLSITE_BINS */
+
+#ifdef SMALL_ARENAS
+/*
+ * Small-object arenas: the bytes of arena runs in use outside the
+ * sbrk heap, which mem_heapsize() does not count.
+ */
+size_t mm_arena_bytes(void);
+#endif /* def SMALL_ARENAS */
+
+#ifdef PRESSURE_PURGE
+/*
+ * Pressure-aware purge: the pressure in per-mille read from a cgroup
+ * v2 directory and a PSI file, and the background thread that keeps
+ * it fresh for the purge. NULL paths mean the system ones.
+ */
+int mm_pressure_read(const char *cgroup_dir, const char *psi_file);
+int mm_pressure_start(const char *cgroup_dir, const char *psi_file);
+void mm_pressure_stop(void);
+#endif /* def PRESSURE_PURGE */
+
+#ifdef PARALLEL_CHECK
+/*
+ * Parallel heap check: what mm_checkheap checks, split over up to
+ * CHECK_THREADS threads. Return -1 if anything is wrong, 0 otherwise.
+ */
+int mm_checkheap_parallel(int threads);
+#endif /* def PARALLEL_CHECK */
+
+#endif /* MM_EXT_H */
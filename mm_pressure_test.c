@@ -0,0 +1,247 @@
+/*
+ * mm_pressure_test.c
+ *
+ * Header Comment:
+ * This program checks the pressure-aware purge against fake cgroup
+ * and PSI files written to a temporary directory: the pressure read
+ * from them, the background thread refreshing it and stopping at
+ * once, and freed blocks losing their pages at full pressure while
+ * the live blocks around them survive.
+ * It prints every failed check and exits with 1 if there was one:
+ *     gcc -O2 -DDRIVER -DPRESSURE_PURGE -o mm_pressure_test mm_pressure_test.c mm_allocator.c memlib.c -lpthread
+ *     ./mm_pressure_test
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "mm_ext.h"
+
+#ifdef SIMULATE
+#error "the purge check writes payloads and cannot be simulated"
+#endif
+
+/* the blocks of the purge check, large enough to be purged */
+#define TEST_BLOCKS 128
+#define TEST_SIZE (32 * 1024)
+
+static char dir[] = "/tmp/mm_pressure.XXXXXX";
+static char psi[64];
+static int failures = 0;
+
+/*
+ * expect - Report a failed check
+ */
+static void expect(int ok, const char *what, long got, long want)
+{
+    if (!ok)
+    {
+        fprintf(stderr, "%s: got %ld, want %ld Error!\n", what, got, want);
+        failures ++;
+    }
+}
+
+/*
+ * put_file - Write text to dir/name, or remove the file when text is NULL
+ */
+static void put_file(const char *name, const char *text)
+{
+    char path[128];
+    FILE *fp;
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    if (text == NULL)
+    {
+        unlink(path);
+        return;
+    }
+    if ((fp = fopen(path, "w")) == NULL)
+    {
+        fprintf(stderr, "Write %s Error!\n", path);
+        exit(1);
+    }
+    fputs(text, fp);
+    fclose(fp);
+}
+
+static long now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+/*
+ * resident_pages - Count the resident pages among the whole pages
+ * inside [p, p + len), add the number of whole pages to *pages
+ */
+static long resident_pages(char *p, size_t len, long *pages)
+{
+    static unsigned char vec[TEST_SIZE * 2 / 4096 + 1];
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    char *start = (char *)(((size_t)p + page - 1) & ~(page - 1));
+    char *end = (char *)(((size_t)p + len) & ~(page - 1));
+    long i, n, resident = 0;
+    if (end <= start)
+        return 0;
+    n = (end - start) / page;
+    if (n > (long)sizeof(vec) || mincore(start, end - start, vec) != 0)
+    {
+        fprintf(stderr, "Mincore Error!\n");
+        exit(1);
+    }
+    for (i = 0; i < n; i++)
+        resident += vec[i] & 1;
+    *pages += n;
+    return resident;
+}
+
+/*
+ * test_read - The cgroup usage against its limit and the PSI average,
+ * the larger one winning, and missing files counting as no pressure
+ */
+static void test_read(void)
+{
+    int level;
+    level = mm_pressure_read(dir, psi);
+    expect(level == 0, "No files", level, 0);
+
+    put_file("memory.current", "500\n");
+    put_file("memory.max", "1000\n");
+    level = mm_pressure_read(dir, psi);
+    expect(level == 500, "Usage 500/1000", level, 500);
+
+    put_file("memory.current", "4000\n");
+    level = mm_pressure_read(dir, psi);
+    expect(level == 1000, "Usage over limit", level, 1000);
+
+    put_file("memory.max", "max\n");
+    level = mm_pressure_read(dir, psi);
+    expect(level == 0, "No limit", level, 0);
+
+    put_file("psi", "some avg10=95.00 avg60=20.00 avg300=5.00 total=1234\n"
+                    "full avg10=10.00 avg60=2.00 avg300=0.50 total=567\n");
+    level = mm_pressure_read(dir, psi);
+    expect(level == 950, "PSI avg10=95", level, 950);
+
+    put_file("memory.max", "1000\n");
+    put_file("memory.current", "100\n");
+    level = mm_pressure_read(dir, psi);
+    expect(level == 950, "PSI over usage", level, 950);
+
+    put_file("psi", "some avg10=1.50 avg60=0.00 avg300=0.00 total=1\n");
+    level = mm_pressure_read(dir, psi);
+    expect(level == 100, "Usage over PSI", level, 100);
+
+    put_file("memory.current", NULL);
+    put_file("memory.max", NULL);
+    put_file("psi", NULL);
+    level = mm_pressure_read(dir, psi);
+    expect(level == 0, "Files removed", level, 0);
+}
+
+/*
+ * test_thread - Start and stop the background thread, which must not
+ * wait out its period when stopped
+ */
+static void test_thread(void)
+{
+    long start;
+    expect(mm_pressure_start(dir, psi) == 0, "Start", -1, 0);
+    expect(mm_pressure_start(dir, psi) == -1, "Start twice", 0, -1);
+    usleep(50 * 1000);
+    start = now_ms();
+    mm_pressure_stop();
+    expect(now_ms() - start < 100, "Stop time in ms", now_ms() - start, 100);
+    expect(mm_pressure_start(dir, psi) == 0, "Restart", -1, 0);
+    mm_pressure_stop();
+}
+
+/*
+ * test_purge - Free large blocks at full pressure, check that the
+ * pages inside them left memory, then reuse them and check that no
+ * live block was touched. Small blocks split off a freed block bring
+ * its first page back, and with HOT_COLD the hot lists are never
+ * purged, so only most of the pages have to be gone.
+ */
+static void test_purge(void)
+{
+    static char *blocks[TEST_BLOCKS];
+    int round, i, j;
+    long resident, pages;
+    put_file("memory.current", "1000\n");
+    put_file("memory.max", "1000\n");
+    if (mm_pressure_start(dir, psi) != 0)
+    {
+        expect(0, "Start at full pressure", -1, 0);
+        return;
+    }
+    for (round = 0; round < 8; round++)
+    {
+        for (i = 0; i < TEST_BLOCKS; i++)
+        {
+            blocks[i] = mm_malloc(TEST_SIZE + i * 64);
+            if (blocks[i] == NULL)
+            {
+                expect(0, "Allocation", 0, TEST_SIZE + i * 64);
+                mm_pressure_stop();
+                return;
+            }
+            memset(blocks[i], i, TEST_SIZE + i * 64);
+        }
+        /* free every other block, with enough frees to reach the purge */
+        for (i = 0; i < TEST_BLOCKS; i += 2)
+            mm_free(blocks[i]);
+        for (i = 0; i < 4096; i++)
+            mm_free(mm_malloc(16));
+        usleep(60 * 1000);
+        for (i = 0; i < 4096; i++)
+            mm_free(mm_malloc(16));
+        resident = pages = 0;
+        for (i = 0; i < TEST_BLOCKS; i += 2)
+            resident += resident_pages(blocks[i], TEST_SIZE + i * 64, &pages);
+        expect(pages > 0 && resident * 2 < pages, "Resident pages of freed blocks",
+               resident, pages / 2);
+        for (i = 1; i < TEST_BLOCKS; i += 2)
+        {
+            for (j = 0; j < TEST_SIZE + i * 64; j++)
+            {
+                if (blocks[i][j] != (char)i)
+                {
+                    expect(0, "Live block byte", blocks[i][j], (char)i);
+                    break;
+                }
+            }
+            mm_free(blocks[i]);
+        }
+    }
+    mm_pressure_stop();
+    put_file("memory.current", NULL);
+    put_file("memory.max", NULL);
+}
+
+int main(void)
+{
+    if (mkdtemp(dir) == NULL)
+    {
+        fprintf(stderr, "Temporary Directory Error!\n");
+        return 1;
+    }
+    snprintf(psi, sizeof(psi), "%s/psi", dir);
+    mem_init();
+    if (mm_init() < 0)
+    {
+        fprintf(stderr, "Heap Initialize Error!\n");
+        return 1;
+    }
+    test_read();
+    test_thread();
+    test_purge();
+    rmdir(dir);
+    printf("%s\n", failures == 0 ? "Pressure tests passed" : "Pressure tests failed");
+    return failures != 0;
+}
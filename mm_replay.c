@@ -0,0 +1,184 @@
+/*
+ * mm_replay.c
+ *
+ * Header Comment:
+ * This program replays a malloc lab trace file against the allocator
+ * and reports the peak heap size and the space utilization, without
+ * ever touching a payload. The trace is streamed, so its length is
+ * only bounded by time.
+ *
+ * Built with -DSIMULATE, the allocator runs on a virtual heap and the
+ * heap size is read through sim_heapsize(), so a what-if run gives
+ * the same utilization as the real one while only keeping the block
+ * tags. With -DCALLSITE_BINS this holds as long as the call sites
+ * of both builds fall into the same bins. The peak RSS of the run
+ * is printed as well:
+ *     gcc -O2 -DDRIVER -o mm_replay mm_replay.c mm_allocator.c memlib.c
+ *     gcc -O2 -DDRIVER -DSIMULATE -o mm_replay_sim mm_replay.c mm_allocator.c memlib.c
+ *     ./mm_replay_sim trace.rep
+ *
+ * The trace format is the driver's: the suggested heap size, the
+ * number of ids, the number of operations and the weight, followed
+ * by one "a id bytes", "r id bytes" or "f id" line per operation.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "mm_ext.h"
+
+#ifdef SIMULATE
+#define replay_heapsize() sim_heapsize()
+#elif defined(SMALL_ARENAS)
+#define replay_heapsize() (mem_heapsize() + mm_arena_bytes())
+#else
+#define replay_heapsize() mem_heapsize()
+#endif
+
+/*
+ * read_number - Read the next unsigned number of the trace, skipping
+ * blanks. Plain getc keeps parsing from dominating long replays.
+ */
+static size_t read_number(FILE *fp)
+{
+    size_t n = 0;
+    int c = getc_unlocked(fp);
+    while (c == ' ' || c == '\t')
+        c = getc_unlocked(fp);
+    while (c >= '0' && c <= '9')
+    {
+        n = n * 10 + (c - '0');
+        c = getc_unlocked(fp);
+    }
+    ungetc(c, fp);
+    return n;
+}
+
+/*
+ * read_op - Read the operation letter of the next line, EOF at the end
+ */
+static int read_op(FILE *fp)
+{
+    int c = getc_unlocked(fp);
+    while (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+        c = getc_unlocked(fp);
+    return c;
+}
+
+/*
+ * read_header - Read the first four numbers of the trace, return the
+ * number of ids or -1 on error
+ */
+static long read_header(FILE *fp)
+{
+    long heap, ids, ops, weight;
+    if (fscanf(fp, "%ld %ld %ld %ld", &heap, &ids, &ops, &weight) != 4 || ids <= 0)
+        return -1;
+    return ids;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *fp;
+    long ids, id, ops = 0;
+    char **blocks;
+    size_t *sizes;
+    size_t bytes, live = 0, peak = 0;
+    int op;
+    struct timespec t0, t1;
+    struct rusage usage;
+    double elapsed;
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s trace\n", argv[0]);
+        return 1;
+    }
+    if ((fp = fopen(argv[1], "r")) == NULL)
+    {
+        fprintf(stderr, "Open Trace %s Error!\n", argv[1]);
+        return 1;
+    }
+    if ((ids = read_header(fp)) < 0)
+    {
+        fprintf(stderr, "Trace Header Error!\n");
+        return 1;
+    }
+    blocks = calloc(ids, sizeof(char *));
+    sizes = calloc(ids, sizeof(size_t));
+    if (blocks == NULL || sizes == NULL)
+    {
+        fprintf(stderr, "Out Of Memory Error!\n");
+        return 1;
+    }
+
+    mem_init();
+    if (mm_init() < 0)
+    {
+        fprintf(stderr, "Heap Initialize Error!\n");
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    while ((op = read_op(fp)) != EOF)
+    {
+        id = (long)read_number(fp);
+        bytes = (op == 'f') ? 0 : read_number(fp);
+        if (id >= ids)
+        {
+            fprintf(stderr, "Trace Id %ld Out Of Range Error!\n", id);
+            return 1;
+        }
+        switch (op)
+        {
+        case 'a':
+            blocks[id] = mm_malloc(bytes);
+            break;
+        case 'r':
+            blocks[id] = mm_realloc(blocks[id], bytes);
+            live -= sizes[id];
+            break;
+        case 'f':
+            mm_free(blocks[id]);
+            blocks[id] = NULL;
+            live -= sizes[id];
+            bytes = 0;
+            break;
+        default:
+            fprintf(stderr, "Trace Operation %c Error!\n", op);
+            return 1;
+        }
+        if (op != 'f' && blocks[id] == NULL)
+        {
+            fprintf(stderr, "Allocation Of %zu Bytes Failed Error!\n", bytes);
+            return 1;
+        }
+        sizes[id] = bytes;
+        live += bytes;
+        if (live > peak)
+            peak = live;
+        ops ++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    printf("Mode: %s\n",
+#ifdef SIMULATE
+           "simulated"
+#else
+           "real"
+#endif
+           );
+    printf("Operations %ld in %.3f s\n", ops, elapsed);
+    printf("Peak Payload %zu bytes, Heap %zu bytes, Utilization %.2f%%\n",
+           peak, replay_heapsize(),
+           replay_heapsize() ? 100.0 * peak / replay_heapsize() : 0.0);
+    getrusage(RUSAGE_SELF, &usage);
+    printf("Peak RSS %ld KB\n", usage.ru_maxrss);
+    fclose(fp);
+    free(blocks);
+    free(sizes);
+    return 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * mm_signal_test.c
+ *
+ * Header Comment:
+ * This program checks the signal-safe pool: sizes it must refuse,
+ * using the pool up, frees of interior, foreign and already free
+ * pointers, and taking and giving back slots from a signal handler
+ * that interrupts a malloc loop.
+ * It prints every failed check and exits with 1 if there was one:
+ *     gcc -O2 -DDRIVER -DSIGNAL_POOL -o mm_signal_test mm_signal_test.c mm_allocator.c memlib.c
+ *     ./mm_signal_test
+ */
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "mm_ext.h"
+
+/* SIGPOOL_SLOTS and SIGPOOL_SLOT in mm_allocator.c */
+#define POOL_SLOTS 256
+#define POOL_SLOT 256
+
+static void *slots[POOL_SLOTS];
+static int failures = 0;
+static volatile sig_atomic_t handled = 0;
+static volatile sig_atomic_t handler_failures = 0;
+
+/*
+ * expect - Report a failed check
+ */
+static void expect(int ok, const char *what)
+{
+    if (!ok)
+    {
+        fprintf(stderr, "%s Error!\n", what);
+        failures ++;
+    }
+}
+
+/*
+ * take_all - Take every free slot, return how many were taken
+ */
+static int take_all(void)
+{
+    int n = 0;
+    void *p;
+    while (n < POOL_SLOTS && (p = mm_malloc_signal_safe(POOL_SLOT)) != NULL)
+        slots[n++] = p;
+    return n;
+}
+
+static void give_all(int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        mm_free_signal_safe(slots[i]);
+}
+
+/*
+ * test_pool - Sizes, using the pool up and the frees it must ignore
+ */
+static void test_pool(void)
+{
+    char local[POOL_SLOT];
+    char *p;
+    int n, i, j;
+    expect(mm_malloc_signal_safe(0) == NULL, "Size 0 Accepted");
+    expect(mm_malloc_signal_safe(POOL_SLOT + 1) == NULL, "Oversized Slot Accepted");
+
+    n = take_all();
+    expect(n == POOL_SLOTS, "Pool Size");
+    expect(mm_malloc_signal_safe(1) == NULL, "Used Up Pool Not Refused");
+    for (i = 0; i < n; i++)
+    {
+        memset(slots[i], i, POOL_SLOT);
+        for (j = 0; j < i; j++)
+            expect(slots[i] != slots[j], "Slot Handed Out Twice");
+    }
+    for (i = 0; i < n; i++)
+    {
+        for (j = 0; j < POOL_SLOT; j++)
+        {
+            if (((unsigned char *)slots[i])[j] != (unsigned char)i)
+            {
+                expect(0, "Slots Overlap");
+                break;
+            }
+        }
+    }
+
+    /* interior and foreign pointers leave the pool used up */
+    mm_free_signal_safe((char *)slots[3] + 8);
+    mm_free_signal_safe((char *)slots[3] + POOL_SLOT - 1);
+    mm_free_signal_safe(local);
+    mm_free_signal_safe(NULL);
+    expect(mm_malloc_signal_safe(1) == NULL, "Interior Or Foreign Free Released A Slot");
+
+    /* a double free releases the slot once */
+    p = slots[5];
+    mm_free_signal_safe(p);
+    mm_free_signal_safe(p);
+    expect(mm_malloc_signal_safe(1) == p, "Freed Slot Not Reused");
+    expect(mm_malloc_signal_safe(1) == NULL, "Double Free Released Two Slots");
+    give_all(n);
+    expect(take_all() == POOL_SLOTS, "Slots Lost");
+    give_all(POOL_SLOTS);
+}
+
+/*
+ * on_alarm - Take and give back slots while the main loop is inside
+ * malloc or free
+ */
+static void on_alarm(int sig)
+{
+    void *p[4];
+    int i;
+    (void)sig;
+    for (i = 0; i < 4; i++)
+    {
+        p[i] = mm_malloc_signal_safe(64);
+        if (p[i] == NULL)
+            handler_failures ++;
+        else
+            memset(p[i], 0xAB, 64);
+    }
+    for (i = 0; i < 4; i++)
+        mm_free_signal_safe(p[i]);
+    handled ++;
+}
+
+/*
+ * test_signal - Interrupt a malloc and free loop with a fast timer
+ */
+static void test_signal(void)
+{
+    struct sigaction sa;
+    struct itimerval timer;
+    void *blocks[64];
+    int i;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_alarm;
+    sigaction(SIGALRM, &sa, NULL);
+    memset(&timer, 0, sizeof(timer));
+    timer.it_interval.tv_usec = 100;
+    timer.it_value.tv_usec = 100;
+    setitimer(ITIMER_REAL, &timer, NULL);
+    memset(blocks, 0, sizeof(blocks));
+    while (handled < 200)
+    {
+        i = rand() % 64;
+        if (blocks[i] != NULL)
+            mm_free(blocks[i]);
+        blocks[i] = mm_malloc(1 + rand() % 2000);
+    }
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_REAL, &timer, NULL);
+    for (i = 0; i < 64; i++)
+        mm_free(blocks[i]);
+    expect(handler_failures == 0, "Handler Allocation");
+    expect(take_all() == POOL_SLOTS, "Handler Slots Lost");
+    give_all(POOL_SLOTS);
+}
+
+int main(void)
+{
+    mem_init();
+    if (mm_init() < 0)
+    {
+        fprintf(stderr, "Heap Initialize Error!\n");
+        return 1;
+    }
+    test_pool();
+    test_signal();
+    printf("%s\n", failures == 0 ? "Signal pool tests passed" : "Signal pool tests failed");
+    return failures != 0;
+}